@@ -0,0 +1,89 @@
+package JNI;
+
+import java.nio.ByteBuffer;
+
+/**
+ * Java entry points for the SIMD string kernels in SIMD/fury.h.
+ * Heap arrays are pinned rather than copied, and direct ByteBuffers are used in place.
+ */
+public final class FuryStrings {
+
+    static {
+        System.loadLibrary("fury_jni");
+    }
+
+    private FuryStrings() {
+    }
+
+    /** Whether every byte is ASCII. */
+    public static boolean isLatin(byte[] bytes, int offset, int length) {
+        checkRange(bytes.length, offset, length);
+        return isLatinNative(bytes, offset, length);
+    }
+
+    /** Whether every byte is ASCII; buffer must be direct. */
+    public static boolean isLatin(ByteBuffer buffer, int offset, int length) {
+        checkDirect(buffer);
+        checkRange(buffer.capacity(), offset, length);
+        return isLatinDirectNative(buffer, offset, length);
+    }
+
+    /** Whether every char fits in Latin-1. */
+    public static boolean isLatin1(char[] chars, int offset, int length) {
+        checkRange(chars.length, offset, length);
+        return isLatin1Native(chars, offset, length);
+    }
+
+    /**
+     * Compress chars to Latin-1 bytes at dst[dstOffset].
+     * Returns the number of bytes written, or -1 (leaving dst untouched) if a char does not fit.
+     */
+    public static int compressLatin1(char[] chars, int offset, int length, byte[] dst, int dstOffset) {
+        checkRange(chars.length, offset, length);
+        checkRange(dst.length, dstOffset, length);
+        return compressLatin1Native(chars, offset, length, dst, dstOffset);
+    }
+
+    /**
+     * Encode chars as UTF-8 at dst[dstOffset] and return the number of bytes written.
+     * dst needs room for 3 * length bytes; lone surrogates are written as '?'.
+     */
+    public static int utf16ToUtf8(char[] chars, int offset, int length, byte[] dst, int dstOffset) {
+        checkRange(chars.length, offset, length);
+        checkRange(dst.length, dstOffset, 3 * length);
+        return utf16ToUtf8Native(chars, offset, length, dst, dstOffset);
+    }
+
+    /** Same as {@link #utf16ToUtf8(char[], int, int, byte[], int)} into a direct ByteBuffer. */
+    public static int utf16ToUtf8(char[] chars, int offset, int length, ByteBuffer dst, int dstOffset) {
+        checkDirect(dst);
+        checkRange(chars.length, offset, length);
+        checkRange(dst.capacity(), dstOffset, 3 * length);
+        return utf16ToUtf8DirectNative(chars, offset, length, dst, dstOffset);
+    }
+
+    private static void checkRange(int arrayLength, int offset, int length) {
+        if (offset < 0 || length < 0 || offset > arrayLength - length) {
+            throw new IndexOutOfBoundsException("offset " + offset + ", length " + length + ", size " + arrayLength);
+        }
+    }
+
+    private static void checkDirect(ByteBuffer buffer) {
+        if (!buffer.isDirect()) {
+            throw new IllegalArgumentException("ByteBuffer must be direct");
+        }
+    }
+
+    private static native boolean isLatinNative(byte[] bytes, int offset, int length);
+
+    private static native boolean isLatinDirectNative(ByteBuffer buffer, int offset, int length);
+
+    private static native boolean isLatin1Native(char[] chars, int offset, int length);
+
+    private static native int compressLatin1Native(char[] chars, int offset, int length, byte[] dst, int dstOffset);
+
+    private static native int utf16ToUtf8Native(char[] chars, int offset, int length, byte[] dst, int dstOffset);
+
+    private static native int utf16ToUtf8DirectNative(char[] chars, int offset, int length, ByteBuffer dst,
+                                                      int dstOffset);
+}
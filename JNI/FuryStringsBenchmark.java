@@ -0,0 +1,118 @@
+package JNI;
+
+import java.nio.ByteBuffer;
+import java.nio.CharBuffer;
+import java.nio.charset.CharsetEncoder;
+import java.nio.charset.StandardCharsets;
+import java.util.Random;
+
+/**
+ * Times the native kernels in FuryStrings against the JDK doing the same work.
+ * Run with -Djava.library.path pointing at the directory holding libfury_jni.
+ */
+public class FuryStringsBenchmark {
+
+    private static final int[] SIZES = {16, 256, 4096, 65536, 1 << 20};
+    private static final int WARMUP_ROUNDS = 5;
+    private static final int MEASURE_ROUNDS = 10;
+    private static final long BYTES_PER_ROUND = 64L << 20;
+
+    // Results are folded in here so the JIT cannot drop the work
+    private static long sink;
+
+    interface Task {
+        long run();
+    }
+
+    public static void main(String[] args) {
+        Random random = new Random(42);
+        for (String corpus : new String[]{"ascii", "latin1", "cjk-10%"}) {
+            for (int size : SIZES) {
+                char[] chars = generate(random, corpus, size);
+                byte[] bytes = new String(chars).getBytes(StandardCharsets.ISO_8859_1);
+                byte[] out = new byte[3 * size];
+                ByteBuffer direct = ByteBuffer.allocateDirect(3 * size);
+                ByteBuffer heapOut = ByteBuffer.wrap(out);
+                CharsetEncoder encoder = StandardCharsets.UTF_8.newEncoder();
+                long iterations = Math.max(1, BYTES_PER_ROUND / (2L * size));
+
+                System.out.println(corpus + ", " + size + " chars");
+                report("  isLatin   JDK   ", iterations, size, () -> jdkIsLatin(bytes) ? 1 : 0);
+                report("  isLatin   native", iterations, size, () -> FuryStrings.isLatin(bytes, 0, size) ? 1 : 0);
+                report("  Latin-1   JDK   ", iterations, size, () -> jdkCompressLatin1(chars, out));
+                report("  Latin-1   native", iterations, size,
+                        () -> FuryStrings.compressLatin1(chars, 0, size, out, 0));
+                report("  UTF-8     JDK   ", iterations, size, () -> {
+                    heapOut.clear();
+                    encoder.reset().encode(CharBuffer.wrap(chars), heapOut, true);
+                    return heapOut.position();
+                });
+                report("  UTF-8     native", iterations, size, () -> FuryStrings.utf16ToUtf8(chars, 0, size, out, 0));
+                report("  UTF-8 direct    ", iterations, size,
+                        () -> FuryStrings.utf16ToUtf8(chars, 0, size, direct, 0));
+            }
+        }
+        System.out.println("sink " + sink);
+    }
+
+    private static void report(String name, long iterations, int size, Task task) {
+        for (int round = 0; round < WARMUP_ROUNDS; round++) {
+            time(iterations, task);
+        }
+        long best = Long.MAX_VALUE;
+        for (int round = 0; round < MEASURE_ROUNDS; round++) {
+            best = Math.min(best, time(iterations, task));
+        }
+        double nsPerOp = (double) best / iterations;
+        System.out.printf("%s %12.1f ns/op %10.1f MB/s%n", name, nsPerOp, size * 1e3 / nsPerOp);
+    }
+
+    private static long time(long iterations, Task task) {
+        long start = System.nanoTime();
+        long result = 0;
+        for (long i = 0; i < iterations; i++) {
+            result += task.run();
+        }
+        sink += result;
+        return System.nanoTime() - start;
+    }
+
+    private static boolean jdkIsLatin(byte[] bytes) {
+        for (byte b : bytes) {
+            if (b < 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    private static int jdkCompressLatin1(char[] chars, byte[] out) {
+        for (char c : chars) {
+            if (c > 0xFF) {
+                return -1;
+            }
+        }
+        for (int i = 0; i < chars.length; i++) {
+            out[i] = (byte) chars[i];
+        }
+        return chars.length;
+    }
+
+    private static char[] generate(Random random, String corpus, int size) {
+        char[] chars = new char[size];
+        for (int i = 0; i < size; i++) {
+            switch (corpus) {
+                case "ascii":
+                    chars[i] = (char) (' ' + random.nextInt(95));
+                    break;
+                case "latin1":
+                    chars[i] = (char) (random.nextInt(8) == 0 ? 0xC0 + random.nextInt(64) : ' ' + random.nextInt(95));
+                    break;
+                default:
+                    chars[i] = (char) (random.nextInt(10) == 0 ? 0x4E00 + random.nextInt(0x5000) : ' ' + random.nextInt(95));
+                    break;
+            }
+        }
+        return chars;
+    }
+}
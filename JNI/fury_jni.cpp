@@ -0,0 +1,103 @@
+// JNI bindings for the SIMD string kernels in SIMD/fury.h, used by JNI/FuryStrings.java.
+// Arrays are pinned with GetPrimitiveArrayCritical instead of copied; no JNI call is made
+// while they are held. The Java side checks offsets and lengths before calling in.
+#include <jni.h>
+
+#include "fury.h"
+
+namespace {
+
+    // Holds a primitive array pinned for the lifetime of the object
+    class CriticalArray {
+    public:
+        CriticalArray(JNIEnv *env, jarray array, jint mode)
+                : env_(env), array_(array), mode_(mode), data_(env->GetPrimitiveArrayCritical(array, nullptr)) {}
+
+        ~CriticalArray() {
+            if (data_ != nullptr) {
+                env_->ReleasePrimitiveArrayCritical(array_, data_, mode_);
+            }
+        }
+
+        CriticalArray(const CriticalArray &) = delete;
+        CriticalArray &operator=(const CriticalArray &) = delete;
+
+        template <typename T>
+        T *as() const {
+            return static_cast<T *>(data_);
+        }
+
+        bool ok() const {
+            return data_ != nullptr;
+        }
+
+    private:
+        JNIEnv *env_;
+        jarray array_;
+        jint mode_;
+        void *data_;
+    };
+
+} // namespace
+
+extern "C" {
+
+JNIEXPORT jboolean JNICALL Java_JNI_FuryStrings_isLatinNative(JNIEnv *env, jclass, jbyteArray bytes, jint offset,
+                                                              jint length) {
+    CriticalArray array(env, bytes, JNI_ABORT);
+    if (!array.ok()) {
+        return JNI_FALSE; // OutOfMemoryError is pending
+    }
+    return fury::isLatin(array.as<const char>() + offset, length) ? JNI_TRUE : JNI_FALSE;
+}
+
+JNIEXPORT jboolean JNICALL Java_JNI_FuryStrings_isLatinDirectNative(JNIEnv *env, jclass, jobject buffer, jint offset,
+                                                                    jint length) {
+    const char *data = static_cast<const char *>(env->GetDirectBufferAddress(buffer));
+    return fury::isLatin(data + offset, length) ? JNI_TRUE : JNI_FALSE;
+}
+
+JNIEXPORT jboolean JNICALL Java_JNI_FuryStrings_isLatin1Native(JNIEnv *env, jclass, jcharArray chars, jint offset,
+                                                               jint length) {
+    CriticalArray array(env, chars, JNI_ABORT);
+    if (!array.ok()) {
+        return JNI_FALSE;
+    }
+    return fury::isLatin1(array.as<const char16_t>() + offset, length) ? JNI_TRUE : JNI_FALSE;
+}
+
+JNIEXPORT jint JNICALL Java_JNI_FuryStrings_compressLatin1Native(JNIEnv *env, jclass, jcharArray chars, jint offset,
+                                                                 jint length, jbyteArray dst, jint dst_offset) {
+    CriticalArray src(env, chars, JNI_ABORT);
+    CriticalArray out(env, dst, 0);
+    if (!src.ok() || !out.ok()) {
+        return 0;
+    }
+    const char16_t *data = src.as<const char16_t>() + offset;
+    if (!fury::isLatin1(data, length)) {
+        return -1;
+    }
+    return static_cast<jint>(fury::compressLatin1(data, length, out.as<uint8_t>() + dst_offset));
+}
+
+JNIEXPORT jint JNICALL Java_JNI_FuryStrings_utf16ToUtf8Native(JNIEnv *env, jclass, jcharArray chars, jint offset,
+                                                              jint length, jbyteArray dst, jint dst_offset) {
+    CriticalArray src(env, chars, JNI_ABORT);
+    CriticalArray out(env, dst, 0);
+    if (!src.ok() || !out.ok()) {
+        return 0;
+    }
+    return static_cast<jint>(fury::utf16ToUtf8(src.as<const char16_t>() + offset, length, out.as<uint8_t>() + dst_offset));
+}
+
+JNIEXPORT jint JNICALL Java_JNI_FuryStrings_utf16ToUtf8DirectNative(JNIEnv *env, jclass, jcharArray chars, jint offset,
+                                                                    jint length, jobject dst, jint dst_offset) {
+    uint8_t *out = static_cast<uint8_t *>(env->GetDirectBufferAddress(dst));
+    CriticalArray src(env, chars, JNI_ABORT);
+    if (!src.ok()) {
+        return 0;
+    }
+    return static_cast<jint>(fury::utf16ToUtf8(src.as<const char16_t>() + offset, length, out + dst_offset));
+}
+
+} // extern "C"
@@ -0,0 +1,3130 @@
+// Apache Fury string kernels. Most operations have a _Baseline version, SIMD versions with
+// _AVX2, _AVX512, _SSE2 or _NEON suffixes, and a dispatcher that picks one for the running CPU.
+// Newer kernels are written once against the simd::Vec layer in vec.h.
+#ifndef POTIMIZER_FURY_H
+#define POTIMIZER_FURY_H
+
+#include <random>
+#include <string>
+#include <cstdint>
+#include <algorithm>
+#include <vector>
+#include <cstring>
+#include <stdexcept>
+#include <type_traits>
+#include <memory>
+
+#include "vec.h"
+
+namespace fury {
+
+    inline int popCount(uint32_t value) {
+#if defined(_MSC_VER)
+        return static_cast<int>(__popcnt(value));
+#else
+        return __builtin_popcount(value);
+#endif
+    }
+
+    inline int countTrailingZeros(uint32_t value) {
+#if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanForward(&index, value);
+        return static_cast<int>(index);
+#else
+        return __builtin_ctz(value);
+#endif
+    }
+
+    inline uint16_t byteSwap16(uint16_t value) {
+#if defined(_MSC_VER)
+        return _byteswap_ushort(value);
+#else
+        return __builtin_bswap16(value);
+#endif
+    }
+
+    inline uint32_t byteSwap32(uint32_t value) {
+#if defined(_MSC_VER)
+        return _byteswap_ulong(value);
+#else
+        return __builtin_bswap32(value);
+#endif
+    }
+
+    inline uint64_t byteSwap64(uint64_t value) {
+#if defined(_MSC_VER)
+        return _byteswap_uint64(value);
+#else
+        return __builtin_bswap64(value);
+#endif
+    }
+
+    inline int countTrailingZeros64(uint64_t value) {
+#if defined(_MSC_VER)
+        unsigned long index;
+        _BitScanForward64(&index, value);
+        return static_cast<int>(index);
+#else
+        return __builtin_ctzll(value);
+#endif
+    }
+
+    inline bool isLatin_Baseline(const char *data, size_t len) {
+        for (size_t i = 0; i < len; ++i) {
+            if (static_cast<unsigned char>(data[i]) >= 128) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    template <typename Arch>
+    FURY_ALWAYS_INLINE bool isLatinKernel(const char *data, size_t len) {
+        typedef simd::Vec<Arch, uint8_t> V;
+        const uint8_t *bytes = reinterpret_cast<const uint8_t *>(data);
+        const V latin_mask = V::splat(0x80);
+        size_t i = 0;
+        for (; i + V::lanes <= len; i += V::lanes) {
+            if (!testz(V::load(bytes + i), latin_mask)) {
+                return false;
+            }
+        }
+        return isLatin_Baseline(data + i, len - i);
+    }
+
+#if defined(__x86_64__) || defined(_M_X64)
+    FURY_TARGET_AVX512 inline bool isLatin_AVX512(const char *data, size_t len) {
+        return isLatinKernel<simd::AVX512>(data, len);
+    }
+
+    FURY_TARGET_AVX2 inline bool isLatin_AVX2(const char *data, size_t len) {
+        return isLatinKernel<simd::AVX2>(data, len);
+    }
+
+    inline bool isLatin_SSE2(const char *data, size_t len) {
+        return isLatinKernel<simd::SSE2>(data, len);
+    }
+#else
+    inline bool isLatin_AVX512(const char *data, size_t len) {
+        return isLatin_Baseline(data, len);
+    }
+
+    inline bool isLatin_AVX2(const char *data, size_t len) {
+        return isLatin_Baseline(data, len);
+    }
+
+    inline bool isLatin_SSE2(const char *data, size_t len) {
+        return isLatin_Baseline(data, len);
+    }
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    inline bool isLatin_NEON(const char *data, size_t len) {
+        return isLatinKernel<simd::NEON>(data, len);
+    }
+#else
+    inline bool isLatin_NEON(const char *data, size_t len) {
+        return isLatin_Baseline(data, len);
+    }
+#endif
+
+#if defined(FURY_HAS_RVV)
+    // The RVV kernels are strip-mined: vsetvl returns how many elements fit this pass, so the
+    // tail needs no scalar loop. Scans use LMUL=8, grouping 8 vector registers per operand,
+    // since they only keep the loaded group and one mask live.
+    inline bool isLatin_RISCV(const char *data, size_t len) {
+        const uint8_t *bytes = reinterpret_cast<const uint8_t *>(data);
+        for (size_t i = 0, vl; i < len; i += vl) {
+            vl = __riscv_vsetvl_e8m8(len - i);
+            vuint8m8_t chars = __riscv_vle8_v_u8m8(bytes + i, vl);
+            vbool1_t non_latin = __riscv_vmsgeu_vx_u8m8_b1(chars, 0x80, vl);
+            if (__riscv_vfirst_m_b1(non_latin, vl) >= 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+#else
+    inline bool isLatin_RISCV(const char *data, size_t len) {
+        return isLatin_Baseline(data, len);
+    }
+#endif
+
+    // Code points in UTF-8 are the bytes that are not continuation bytes (0b10xxxxxx)
+    inline size_t count_code_points_utf8_Baseline(const char *data, size_t len) {
+        size_t count = 0;
+        for (size_t i = 0; i < len; ++i) {
+            count += (static_cast<unsigned char>(data[i]) & 0xC0) != 0x80;
+        }
+        return count;
+    }
+
+    // Code points in UTF-16 are the code units minus the low surrogates
+    inline size_t count_code_points_utf16_Baseline(const char16_t *data, size_t len) {
+        size_t count = len;
+        for (size_t i = 0; i < len; ++i) {
+            count -= (data[i] & 0xFC00) == 0xDC00;
+        }
+        return count;
+    }
+
+    // Continuation bytes are counted in per-lane counters, summed before they can wrap
+    template <typename Arch>
+    FURY_ALWAYS_INLINE size_t countCodePointsUtf8Kernel(const char *data, size_t len) {
+        typedef simd::Vec<Arch, uint8_t> V;
+        const uint8_t *bytes = reinterpret_cast<const uint8_t *>(data);
+        const V top_bits = V::splat(0xC0);
+        const V continuation = V::splat(0x80);
+        const size_t vector_end = len - len % V::lanes;
+        size_t continuations = 0;
+        size_t i = 0;
+        while (i < vector_end) {
+            V counts = V::zero();
+            size_t block_end = std::min(vector_end, i + V::lanes * 255);
+            for (; i < block_end; i += V::lanes) {
+                counts = counts - eq(V::load(bytes + i) & top_bits, continuation);
+            }
+            continuations += sumLanes(counts);
+        }
+        return i - continuations + count_code_points_utf8_Baseline(data + i, len - i);
+    }
+
+    template <typename Arch>
+    FURY_ALWAYS_INLINE size_t countCodePointsUtf16Kernel(const char16_t *data, size_t len) {
+        typedef simd::Vec<Arch, uint16_t> V;
+        const uint16_t *units = reinterpret_cast<const uint16_t *>(data);
+        const V surrogate_mask = V::splat(0xFC00);
+        const V low_surrogate = V::splat(0xDC00);
+        const size_t vector_end = len - len % V::lanes;
+        size_t lows = 0;
+        size_t i = 0;
+        while (i < vector_end) {
+            V counts = V::zero();
+            size_t block_end = std::min(vector_end, i + V::lanes * 65535);
+            for (; i < block_end; i += V::lanes) {
+                counts = counts - eq(V::load(units + i) & surrogate_mask, low_surrogate);
+            }
+            lows += sumLanes(counts);
+        }
+        return i - lows + count_code_points_utf16_Baseline(data + i, len - i);
+    }
+
+#if defined(__x86_64__) || defined(_M_X64)
+    inline bool cpuSupportsAVX2() {
+#if defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7) {
+            return false;
+        }
+        __cpuid(info, 1);
+        bool osxsave = (info[2] & (1 << 27)) != 0;
+        if (!osxsave || (_xgetbv(0) & 0x6) != 0x6) {
+            return false;
+        }
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 5)) != 0;
+#else
+        return __builtin_cpu_supports("avx2");
+#endif
+    }
+
+    // AVX-512BW adds two more XSAVE state components (opmask and the upper ZMM registers)
+    inline bool cpuSupportsAVX512BW() {
+#if defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 0);
+        if (info[0] < 7) {
+            return false;
+        }
+        __cpuid(info, 1);
+        bool osxsave = (info[2] & (1 << 27)) != 0;
+        if (!osxsave || (_xgetbv(0) & 0xE6) != 0xE6) {
+            return false;
+        }
+        __cpuidex(info, 7, 0);
+        return (info[1] & (1 << 16)) != 0 && (info[1] & (1 << 30)) != 0;
+#else
+        return __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw");
+#endif
+    }
+
+    FURY_TARGET_AVX512 inline size_t count_code_points_utf8_AVX512(const char *data, size_t len) {
+        return countCodePointsUtf8Kernel<simd::AVX512>(data, len);
+    }
+
+    FURY_TARGET_AVX512 inline size_t count_code_points_utf16_AVX512(const char16_t *data, size_t len) {
+        return countCodePointsUtf16Kernel<simd::AVX512>(data, len);
+    }
+
+    FURY_TARGET_AVX2 inline size_t count_code_points_utf8_AVX2(const char *data, size_t len) {
+        return countCodePointsUtf8Kernel<simd::AVX2>(data, len);
+    }
+
+    FURY_TARGET_AVX2 inline size_t count_code_points_utf16_AVX2(const char16_t *data, size_t len) {
+        return countCodePointsUtf16Kernel<simd::AVX2>(data, len);
+    }
+
+    inline size_t count_code_points_utf8_SSE2(const char *data, size_t len) {
+        return countCodePointsUtf8Kernel<simd::SSE2>(data, len);
+    }
+
+    inline size_t count_code_points_utf16_SSE2(const char16_t *data, size_t len) {
+        return countCodePointsUtf16Kernel<simd::SSE2>(data, len);
+    }
+#else
+    inline size_t count_code_points_utf8_AVX512(const char *data, size_t len) {
+        return count_code_points_utf8_Baseline(data, len);
+    }
+
+    inline size_t count_code_points_utf16_AVX512(const char16_t *data, size_t len) {
+        return count_code_points_utf16_Baseline(data, len);
+    }
+
+    inline size_t count_code_points_utf8_AVX2(const char *data, size_t len) {
+        return count_code_points_utf8_Baseline(data, len);
+    }
+
+    inline size_t count_code_points_utf16_AVX2(const char16_t *data, size_t len) {
+        return count_code_points_utf16_Baseline(data, len);
+    }
+
+    inline size_t count_code_points_utf8_SSE2(const char *data, size_t len) {
+        return count_code_points_utf8_Baseline(data, len);
+    }
+
+    inline size_t count_code_points_utf16_SSE2(const char16_t *data, size_t len) {
+        return count_code_points_utf16_Baseline(data, len);
+    }
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    inline size_t count_code_points_utf8_NEON(const char *data, size_t len) {
+        return countCodePointsUtf8Kernel<simd::NEON>(data, len);
+    }
+
+    inline size_t count_code_points_utf16_NEON(const char16_t *data, size_t len) {
+        return countCodePointsUtf16Kernel<simd::NEON>(data, len);
+    }
+#else
+    inline size_t count_code_points_utf8_NEON(const char *data, size_t len) {
+        return count_code_points_utf8_Baseline(data, len);
+    }
+
+    inline size_t count_code_points_utf16_NEON(const char16_t *data, size_t len) {
+        return count_code_points_utf16_Baseline(data, len);
+    }
+#endif
+
+#if defined(FURY_HAS_RVV)
+    inline size_t count_code_points_utf8_RISCV(const char *data, size_t len) {
+        const uint8_t *bytes = reinterpret_cast<const uint8_t *>(data);
+        size_t continuations = 0;
+        for (size_t i = 0, vl; i < len; i += vl) {
+            vl = __riscv_vsetvl_e8m8(len - i);
+            vuint8m8_t top_bits = __riscv_vand_vx_u8m8(__riscv_vle8_v_u8m8(bytes + i, vl), 0xC0, vl);
+            continuations += __riscv_vcpop_m_b1(__riscv_vmseq_vx_u8m8_b1(top_bits, 0x80, vl), vl);
+        }
+        return len - continuations;
+    }
+
+    inline size_t count_code_points_utf16_RISCV(const char16_t *data, size_t len) {
+        const uint16_t *units = reinterpret_cast<const uint16_t *>(data);
+        size_t lows = 0;
+        for (size_t i = 0, vl; i < len; i += vl) {
+            vl = __riscv_vsetvl_e16m8(len - i);
+            vuint16m8_t top_bits = __riscv_vand_vx_u16m8(__riscv_vle16_v_u16m8(units + i, vl), 0xFC00, vl);
+            lows += __riscv_vcpop_m_b2(__riscv_vmseq_vx_u16m8_b2(top_bits, 0xDC00, vl), vl);
+        }
+        return len - lows;
+    }
+#else
+    inline size_t count_code_points_utf8_RISCV(const char *data, size_t len) {
+        return count_code_points_utf8_Baseline(data, len);
+    }
+
+    inline size_t count_code_points_utf16_RISCV(const char16_t *data, size_t len) {
+        return count_code_points_utf16_Baseline(data, len);
+    }
+#endif
+
+    // Pick the widest kernel the running CPU supports, once per process
+    inline size_t count_code_points_utf8(const char *data, size_t len) {
+#if defined(__x86_64__) || defined(_M_X64)
+        static const auto impl = cpuSupportsAVX512BW() ? count_code_points_utf8_AVX512
+                                 : cpuSupportsAVX2() ? count_code_points_utf8_AVX2 : count_code_points_utf8_SSE2;
+#elif defined(FURY_HAS_RVV)
+        static const auto impl = count_code_points_utf8_RISCV;
+#else
+        static const auto impl = count_code_points_utf8_NEON;
+#endif
+        return impl(data, len);
+    }
+
+    inline size_t count_code_points_utf16(const char16_t *data, size_t len) {
+#if defined(__x86_64__) || defined(_M_X64)
+        static const auto impl = cpuSupportsAVX512BW() ? count_code_points_utf16_AVX512
+                                 : cpuSupportsAVX2() ? count_code_points_utf16_AVX2 : count_code_points_utf16_SSE2;
+#elif defined(FURY_HAS_RVV)
+        static const auto impl = count_code_points_utf16_RISCV;
+#else
+        static const auto impl = count_code_points_utf16_NEON;
+#endif
+        return impl(data, len);
+    }
+
+    inline size_t count_code_points_utf8(const std::string &str) {
+        return count_code_points_utf8(str.data(), str.size());
+    }
+
+    inline size_t count_code_points_utf16(const std::u16string &str) {
+        return count_code_points_utf16(str.data(), str.size());
+    }
+
+    // Longest prefix of at most max_bytes that does not split a UTF-8 sequence. Only the
+    // bytes around the cut are looked at, so the cost does not depend on the input length.
+    inline size_t truncate_utf8_bytes(const std::string &str, size_t max_bytes) {
+        if (str.size() <= max_bytes) {
+            return str.size();
+        }
+        size_t end = max_bytes;
+        for (int k = 0; k < 3 && end > 0 && (static_cast<unsigned char>(str[end]) & 0xC0) == 0x80; ++k) {
+            --end;
+        }
+        return end;
+    }
+
+    // Longest prefix of at most max_units that does not split a surrogate pair
+    inline size_t truncate_utf16_units(const std::u16string &str, size_t max_units) {
+        if (str.size() <= max_units) {
+            return str.size();
+        }
+        if (max_units > 0 && (str[max_units] & 0xFC00) == 0xDC00 && (str[max_units - 1] & 0xFC00) == 0xD800) {
+            return max_units - 1;
+        }
+        return max_units;
+    }
+
+    // Byte length of the prefix holding the first max_code_points code points
+    inline size_t truncate_utf8_code_points_Baseline(const std::string &str, size_t max_code_points) {
+        for (size_t i = 0; i < str.size(); ++i) {
+            if ((static_cast<unsigned char>(str[i]) & 0xC0) != 0x80) {
+                if (max_code_points == 0) {
+                    return i;
+                }
+                --max_code_points;
+            }
+        }
+        return str.size();
+    }
+
+    // Unit length of the prefix holding the first max_code_points code points
+    inline size_t truncate_utf16_code_points_Baseline(const std::u16string &str, size_t max_code_points) {
+        for (size_t i = 0; i < str.size(); ++i) {
+            if ((str[i] & 0xFC00) != 0xDC00) {
+                if (max_code_points == 0) {
+                    return i;
+                }
+                --max_code_points;
+            }
+        }
+        return str.size();
+    }
+
+#if defined(__x86_64__) || defined(_M_X64)
+    // Count code point starts per block with popcount and only look for the exact
+    // boundary in the block where the budget runs out
+    FURY_TARGET_AVX2 inline size_t truncate_utf8_code_points_AVX2(const std::string &str, size_t max_code_points) {
+        const char *data = str.data();
+        size_t len = str.size();
+
+        const __m256i continuation_limit = _mm256_set1_epi8(-64);
+        size_t i = 0;
+        for (; i + 32 <= len; i += 32) {
+            __m256i chars = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+            uint32_t starts = ~static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpgt_epi8(continuation_limit, chars)));
+            size_t count = popCount(starts);
+            if (count > max_code_points) {
+                for (size_t k = 0; k < max_code_points; ++k) {
+                    starts &= starts - 1;
+                }
+                return i + countTrailingZeros(starts);
+            }
+            max_code_points -= count;
+        }
+
+        for (; i < len; ++i) {
+            if ((static_cast<unsigned char>(data[i]) & 0xC0) != 0x80) {
+                if (max_code_points == 0) {
+                    return i;
+                }
+                --max_code_points;
+            }
+        }
+        return len;
+    }
+
+    FURY_TARGET_AVX2 inline size_t truncate_utf16_code_points_AVX2(const std::u16string &str, size_t max_code_points) {
+        const char16_t *data = str.data();
+        size_t len = str.size();
+
+        const __m256i surrogate_mask = _mm256_set1_epi16(static_cast<short>(0xFC00));
+        const __m256i low_surrogate = _mm256_set1_epi16(static_cast<short>(0xDC00));
+        size_t i = 0;
+        for (; i + 16 <= len; i += 16) {
+            __m256i chars = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+            __m256i is_low = _mm256_cmpeq_epi16(_mm256_and_si256(chars, surrogate_mask), low_surrogate);
+            // Two mask bits per code unit
+            uint32_t starts = ~static_cast<uint32_t>(_mm256_movemask_epi8(is_low));
+            size_t count = popCount(starts) / 2;
+            if (count > max_code_points) {
+                for (size_t k = 0; k < max_code_points * 2; ++k) {
+                    starts &= starts - 1;
+                }
+                return i + countTrailingZeros(starts) / 2;
+            }
+            max_code_points -= count;
+        }
+
+        for (; i < len; ++i) {
+            if ((data[i] & 0xFC00) != 0xDC00) {
+                if (max_code_points == 0) {
+                    return i;
+                }
+                --max_code_points;
+            }
+        }
+        return len;
+    }
+#else
+    inline size_t truncate_utf8_code_points_AVX2(const std::string &str, size_t max_code_points) {
+        return truncate_utf8_code_points_Baseline(str, max_code_points);
+    }
+
+    inline size_t truncate_utf16_code_points_AVX2(const std::u16string &str, size_t max_code_points) {
+        return truncate_utf16_code_points_Baseline(str, max_code_points);
+    }
+#endif
+
+    inline size_t truncate_utf8_code_points(const std::string &str, size_t max_code_points) {
+#if defined(__x86_64__) || defined(_M_X64)
+        static const auto impl = cpuSupportsAVX2() ? truncate_utf8_code_points_AVX2 : truncate_utf8_code_points_Baseline;
+#else
+        static const auto impl = truncate_utf8_code_points_Baseline;
+#endif
+        return impl(str, max_code_points);
+    }
+
+    inline size_t truncate_utf16_code_points(const std::u16string &str, size_t max_code_points) {
+#if defined(__x86_64__) || defined(_M_X64)
+        static const auto impl = cpuSupportsAVX2() ? truncate_utf16_code_points_AVX2 : truncate_utf16_code_points_Baseline;
+#else
+        static const auto impl = truncate_utf16_code_points_Baseline;
+#endif
+        return impl(str, max_code_points);
+    }
+
+    // Byte classes of one 64-byte JSON block, bit i describing byte i
+    struct JsonBlockMasks {
+        uint64_t backslash;
+        uint64_t quote;
+        uint64_t op;         // { } [ ] : ,
+        uint64_t whitespace; // space, \t, \n, \r
+    };
+
+    inline JsonBlockMasks classifyJsonBlock_Baseline(const char *block) {
+        JsonBlockMasks masks = {0, 0, 0, 0};
+        for (int i = 0; i < 64; ++i) {
+            uint64_t bit = uint64_t(1) << i;
+            switch (block[i]) {
+                case '\\': masks.backslash |= bit; break;
+                case '"': masks.quote |= bit; break;
+                case '{': case '}': case '[': case ']': case ':': case ',': masks.op |= bit; break;
+                case ' ': case '\t': case '\n': case '\r': masks.whitespace |= bit; break;
+                default: break;
+            }
+        }
+        return masks;
+    }
+
+#if defined(__x86_64__) || defined(_M_X64)
+    FURY_TARGET_AVX2 inline uint64_t jsonMask_AVX2(__m256i low, __m256i high, char c) {
+        __m256i target = _mm256_set1_epi8(c);
+        uint32_t lo = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(low, target)));
+        uint32_t hi = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(high, target)));
+        return lo | (uint64_t(hi) << 32);
+    }
+
+    FURY_TARGET_AVX2 inline JsonBlockMasks classifyJsonBlock_AVX2(const char *block) {
+        __m256i low = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(block));
+        __m256i high = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(block + 32));
+
+        JsonBlockMasks masks;
+        masks.backslash = jsonMask_AVX2(low, high, '\\');
+        masks.quote = jsonMask_AVX2(low, high, '"');
+        masks.op = jsonMask_AVX2(low, high, '{') | jsonMask_AVX2(low, high, '}') |
+                   jsonMask_AVX2(low, high, '[') | jsonMask_AVX2(low, high, ']') |
+                   jsonMask_AVX2(low, high, ':') | jsonMask_AVX2(low, high, ',');
+        masks.whitespace = jsonMask_AVX2(low, high, ' ') | jsonMask_AVX2(low, high, '\t') |
+                           jsonMask_AVX2(low, high, '\n') | jsonMask_AVX2(low, high, '\r');
+        return masks;
+    }
+#else
+    inline JsonBlockMasks classifyJsonBlock_AVX2(const char *block) {
+        return classifyJsonBlock_Baseline(block);
+    }
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    // Gather the top bit of each byte of four compare results into one 64-bit mask
+    inline uint64_t neonMovemask64(uint8x16_t m0, uint8x16_t m1, uint8x16_t m2, uint8x16_t m3) {
+        const uint8x16_t bits = {0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80,
+                                 0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40, 0x80};
+        uint8x16_t sum0 = vpaddq_u8(vandq_u8(m0, bits), vandq_u8(m1, bits));
+        uint8x16_t sum1 = vpaddq_u8(vandq_u8(m2, bits), vandq_u8(m3, bits));
+        sum0 = vpaddq_u8(sum0, sum1);
+        sum0 = vpaddq_u8(sum0, sum0);
+        return vgetq_lane_u64(vreinterpretq_u64_u8(sum0), 0);
+    }
+
+    inline uint64_t jsonMask_NEON(const uint8x16_t chunks[4], uint8_t c) {
+        uint8x16_t target = vdupq_n_u8(c);
+        return neonMovemask64(vceqq_u8(chunks[0], target), vceqq_u8(chunks[1], target),
+                              vceqq_u8(chunks[2], target), vceqq_u8(chunks[3], target));
+    }
+
+    inline JsonBlockMasks classifyJsonBlock_NEON(const char *block) {
+        const uint8_t *data = reinterpret_cast<const uint8_t *>(block);
+        uint8x16_t chunks[4] = {vld1q_u8(data), vld1q_u8(data + 16), vld1q_u8(data + 32), vld1q_u8(data + 48)};
+
+        JsonBlockMasks masks;
+        masks.backslash = jsonMask_NEON(chunks, '\\');
+        masks.quote = jsonMask_NEON(chunks, '"');
+        masks.op = jsonMask_NEON(chunks, '{') | jsonMask_NEON(chunks, '}') |
+                   jsonMask_NEON(chunks, '[') | jsonMask_NEON(chunks, ']') |
+                   jsonMask_NEON(chunks, ':') | jsonMask_NEON(chunks, ',');
+        masks.whitespace = jsonMask_NEON(chunks, ' ') | jsonMask_NEON(chunks, '\t') |
+                           jsonMask_NEON(chunks, '\n') | jsonMask_NEON(chunks, '\r');
+        return masks;
+    }
+#else
+    inline JsonBlockMasks classifyJsonBlock_NEON(const char *block) {
+        return classifyJsonBlock_Baseline(block);
+    }
+#endif
+
+    // Inclusive prefix XOR: bit i becomes the XOR of bits 0..i
+    inline uint64_t prefixXor(uint64_t bits) {
+        bits ^= bits << 1;
+        bits ^= bits << 2;
+        bits ^= bits << 4;
+        bits ^= bits << 8;
+        bits ^= bits << 16;
+        bits ^= bits << 32;
+        return bits;
+    }
+
+    // Stage 1 of simdjson (https://arxiv.org/pdf/1902.08318.pdf): turn per-block byte classes
+    // into the offsets of every structural character outside strings, every opening quote,
+    // and the first byte of every scalar (number, true, false, null). Returns false when the
+    // input ends inside a string.
+    template <JsonBlockMasks (*classify)(const char *)>
+    inline bool findStructurals(const std::string &json, std::vector<uint32_t> &offsets) {
+        const uint64_t even_bits = 0x5555555555555555ULL;
+        const uint64_t odd_bits = ~even_bits;
+
+        uint64_t prev_ends_odd_backslash = 0;
+        uint64_t prev_in_string = 0;
+        uint64_t prev_ends_pseudo_pred = 1; // The input start acts like whitespace
+
+        offsets.clear();
+        size_t len = json.size();
+        char tail[64];
+        for (size_t base = 0; base < len; base += 64) {
+            const char *block = json.data() + base;
+            if (len - base < 64) {
+                // Pad the last block with whitespace, which never creates a structural
+                std::fill(tail, tail + 64, ' ');
+                std::copy(block, json.data() + len, tail);
+                block = tail;
+            }
+            JsonBlockMasks masks = classify(block);
+
+            // Characters escaped by an odd-length run of backslashes
+            uint64_t start_edges = masks.backslash & ~(masks.backslash << 1);
+            uint64_t even_start_mask = even_bits ^ prev_ends_odd_backslash;
+            uint64_t even_starts = start_edges & even_start_mask;
+            uint64_t odd_starts = start_edges & ~even_start_mask;
+            uint64_t even_carries = masks.backslash + even_starts;
+            uint64_t odd_carries = masks.backslash + odd_starts;
+            bool ends_odd_backslash = odd_carries < masks.backslash;
+            odd_carries |= prev_ends_odd_backslash;
+            prev_ends_odd_backslash = ends_odd_backslash ? 1 : 0;
+            uint64_t even_carry_ends = even_carries & ~masks.backslash;
+            uint64_t odd_carry_ends = odd_carries & ~masks.backslash;
+            uint64_t escaped = (even_carry_ends & odd_bits) | (odd_carry_ends & even_bits);
+
+            // Inside a string: from an unescaped opening quote up to, not including, the closing one
+            uint64_t quotes = masks.quote & ~escaped;
+            uint64_t in_string = prefixXor(quotes) ^ prev_in_string;
+            prev_in_string = static_cast<uint64_t>(static_cast<int64_t>(in_string) >> 63);
+
+            uint64_t structurals = (masks.op & ~in_string) | quotes;
+            // A scalar starts at a non-blank byte outside strings that follows a blank or structural
+            uint64_t pseudo_pred = structurals | masks.whitespace;
+            uint64_t shifted_pseudo_pred = (pseudo_pred << 1) | prev_ends_pseudo_pred;
+            prev_ends_pseudo_pred = pseudo_pred >> 63;
+            structurals |= shifted_pseudo_pred & ~masks.whitespace & ~in_string;
+            // Closing quotes are implied by the opening ones
+            structurals &= ~(quotes & ~in_string);
+
+            while (structurals != 0) {
+                offsets.push_back(static_cast<uint32_t>(base + countTrailingZeros64(structurals)));
+                structurals &= structurals - 1;
+            }
+        }
+
+        return prev_in_string == 0;
+    }
+
+    inline bool findStructurals_Baseline(const std::string &json, std::vector<uint32_t> &offsets) {
+        return findStructurals<classifyJsonBlock_Baseline>(json, offsets);
+    }
+
+    inline bool findStructurals_AVX2(const std::string &json, std::vector<uint32_t> &offsets) {
+        return findStructurals<classifyJsonBlock_AVX2>(json, offsets);
+    }
+
+    inline bool findStructurals_NEON(const std::string &json, std::vector<uint32_t> &offsets) {
+        return findStructurals<classifyJsonBlock_NEON>(json, offsets);
+    }
+
+    inline bool findStructurals(const std::string &json, std::vector<uint32_t> &offsets) {
+#if defined(__x86_64__) || defined(_M_X64)
+        static const auto impl = cpuSupportsAVX2() ? findStructurals_AVX2 : findStructurals_Baseline;
+#else
+        static const auto impl = findStructurals_NEON;
+#endif
+        return impl(json, offsets);
+    }
+
+    // An arbitrary set of byte values compiled for pshufb/tbl lookups: byte b is in the set when
+    // low[b & 0xF] & high[b >> 4] is non-zero. High nibbles that accept the same low nibbles
+    // share one of the 8 table bits; sets needing more than 8 such groups use a second table
+    // pair, one bit per high nibble, so any of the 2^256 sets stays exact.
+    struct ByteClass {
+        uint64_t members[4];
+        uint8_t low[2][16];
+        uint8_t high[2][16];
+        bool dual;
+    };
+
+    inline bool inByteClass(const ByteClass &set, unsigned char c) {
+        return (set.members[c >> 6] >> (c & 63)) & 1;
+    }
+
+    inline ByteClass compileByteClass(const uint64_t members[4]) {
+        ByteClass set;
+        std::copy(members, members + 4, set.members);
+        std::fill(&set.low[0][0], &set.low[0][0] + 32, 0);
+        std::fill(&set.high[0][0], &set.high[0][0] + 32, 0);
+
+        // For each high nibble, the low nibbles it accepts
+        uint16_t patterns[16] = {0};
+        for (int c = 0; c < 256; ++c) {
+            if (inByteClass(set, static_cast<unsigned char>(c))) {
+                patterns[c >> 4] |= 1 << (c & 0xF);
+            }
+        }
+
+        std::vector<uint16_t> groups;
+        for (int h = 0; h < 16; ++h) {
+            if (patterns[h] != 0 && std::find(groups.begin(), groups.end(), patterns[h]) == groups.end()) {
+                groups.push_back(patterns[h]);
+            }
+        }
+
+        set.dual = groups.size() > 8;
+        for (int h = 0; h < 16; ++h) {
+            if (patterns[h] == 0) {
+                continue;
+            }
+            int table = set.dual ? h / 8 : 0;
+            int bit = set.dual ? h % 8 : static_cast<int>(std::find(groups.begin(), groups.end(), patterns[h]) - groups.begin());
+            set.high[table][h] |= 1 << bit;
+            for (int l = 0; l < 16; ++l) {
+                if ((patterns[h] >> l) & 1) {
+                    set.low[table][l] |= 1 << bit;
+                }
+            }
+        }
+        return set;
+    }
+
+    inline ByteClass compileByteClass(const std::string &chars) {
+        uint64_t members[4] = {0, 0, 0, 0};
+        for (char c : chars) {
+            unsigned char b = static_cast<unsigned char>(c);
+            members[b >> 6] |= uint64_t(1) << (b & 63);
+        }
+        return compileByteClass(members);
+    }
+
+    // Position of the first byte at or after pos that is in the set, or std::string::npos
+    inline size_t findFirstOf_Baseline(const std::string &str, const ByteClass &set, size_t pos = 0) {
+        for (size_t i = pos; i < str.size(); ++i) {
+            if (inByteClass(set, static_cast<unsigned char>(str[i]))) {
+                return i;
+            }
+        }
+        return std::string::npos;
+    }
+
+    // Bit i of bitmap[i / 64] is set when str[i] is in the set
+    inline void matchByteClass_Baseline(const std::string &str, const ByteClass &set, std::vector<uint64_t> &bitmap) {
+        bitmap.assign((str.size() + 63) / 64, 0);
+        for (size_t i = 0; i < str.size(); ++i) {
+            if (inByteClass(set, static_cast<unsigned char>(str[i]))) {
+                bitmap[i / 64] |= uint64_t(1) << (i % 64);
+            }
+        }
+    }
+
+#if defined(__x86_64__) || defined(_M_X64)
+    struct ByteClassTables_AVX2 {
+        __m256i low[2];
+        __m256i high[2];
+        bool dual;
+    };
+
+    FURY_TARGET_AVX2 inline ByteClassTables_AVX2 loadByteClass_AVX2(const ByteClass &set) {
+        ByteClassTables_AVX2 tables;
+        for (int t = 0; t < 2; ++t) {
+            tables.low[t] = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(set.low[t])));
+            tables.high[t] = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(set.high[t])));
+        }
+        tables.dual = set.dual;
+        return tables;
+    }
+
+    // Bit i of the result is set when byte i of the 32 loaded bytes is in the set
+    FURY_TARGET_AVX2 inline uint32_t matchByteClassBlock_AVX2(const ByteClassTables_AVX2 &tables, const char *data) {
+        const __m256i nibble_mask = _mm256_set1_epi8(0x0F);
+        __m256i chars = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data));
+        __m256i low_nibbles = _mm256_and_si256(chars, nibble_mask);
+        __m256i high_nibbles = _mm256_and_si256(_mm256_srli_epi16(chars, 4), nibble_mask);
+
+        __m256i hits = _mm256_and_si256(_mm256_shuffle_epi8(tables.low[0], low_nibbles),
+                                        _mm256_shuffle_epi8(tables.high[0], high_nibbles));
+        if (tables.dual) {
+            hits = _mm256_or_si256(hits, _mm256_and_si256(_mm256_shuffle_epi8(tables.low[1], low_nibbles),
+                                                          _mm256_shuffle_epi8(tables.high[1], high_nibbles)));
+        }
+        return ~static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(hits, _mm256_setzero_si256())));
+    }
+
+    FURY_TARGET_AVX2 inline size_t findFirstOf_AVX2(const std::string &str, const ByteClass &set, size_t pos = 0) {
+        const char *data = str.data();
+        size_t len = str.size();
+        if (pos >= len) {
+            return std::string::npos;
+        }
+        ByteClassTables_AVX2 tables = loadByteClass_AVX2(set);
+
+        size_t i = pos;
+        for (; len - i >= 32; i += 32) {
+            uint32_t matches = matchByteClassBlock_AVX2(tables, data + i);
+            if (matches != 0) {
+                return i + countTrailingZeros(matches);
+            }
+        }
+
+        for (; i < len; ++i) {
+            if (inByteClass(set, static_cast<unsigned char>(data[i]))) {
+                return i;
+            }
+        }
+        return std::string::npos;
+    }
+
+    FURY_TARGET_AVX2 inline void matchByteClass_AVX2(const std::string &str, const ByteClass &set, std::vector<uint64_t> &bitmap) {
+        const char *data = str.data();
+        size_t len = str.size();
+        ByteClassTables_AVX2 tables = loadByteClass_AVX2(set);
+        bitmap.assign((len + 63) / 64, 0);
+
+        size_t i = 0;
+        for (; i + 64 <= len; i += 64) {
+            bitmap[i / 64] = matchByteClassBlock_AVX2(tables, data + i) |
+                             (uint64_t(matchByteClassBlock_AVX2(tables, data + i + 32)) << 32);
+        }
+
+        for (; i < len; ++i) {
+            if (inByteClass(set, static_cast<unsigned char>(data[i]))) {
+                bitmap[i / 64] |= uint64_t(1) << (i % 64);
+            }
+        }
+    }
+#else
+    inline size_t findFirstOf_AVX2(const std::string &str, const ByteClass &set, size_t pos = 0) {
+        return findFirstOf_Baseline(str, set, pos);
+    }
+
+    inline void matchByteClass_AVX2(const std::string &str, const ByteClass &set, std::vector<uint64_t> &bitmap) {
+        matchByteClass_Baseline(str, set, bitmap);
+    }
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    // 0xFF for each of the 16 bytes at data that is in the set
+    inline uint8x16_t matchByteClassBlock_NEON(const ByteClass &set, const char *data) {
+        uint8x16_t chars = vld1q_u8(reinterpret_cast<const uint8_t *>(data));
+        uint8x16_t low_nibbles = vandq_u8(chars, vdupq_n_u8(0x0F));
+        uint8x16_t high_nibbles = vshrq_n_u8(chars, 4);
+
+        uint8x16_t hits = vandq_u8(vqtbl1q_u8(vld1q_u8(set.low[0]), low_nibbles),
+                                   vqtbl1q_u8(vld1q_u8(set.high[0]), high_nibbles));
+        if (set.dual) {
+            hits = vorrq_u8(hits, vandq_u8(vqtbl1q_u8(vld1q_u8(set.low[1]), low_nibbles),
+                                           vqtbl1q_u8(vld1q_u8(set.high[1]), high_nibbles)));
+        }
+        return vtstq_u8(hits, hits);
+    }
+
+    inline size_t findFirstOf_NEON(const std::string &str, const ByteClass &set, size_t pos = 0) {
+        const char *data = str.data();
+        size_t len = str.size();
+        if (pos >= len) {
+            return std::string::npos;
+        }
+
+        size_t i = pos;
+        for (; len - i >= 16; i += 16) {
+            if (vmaxvq_u8(matchByteClassBlock_NEON(set, data + i)) != 0) {
+                break;
+            }
+        }
+
+        for (; i < len; ++i) {
+            if (inByteClass(set, static_cast<unsigned char>(data[i]))) {
+                return i;
+            }
+        }
+        return std::string::npos;
+    }
+
+    inline void matchByteClass_NEON(const std::string &str, const ByteClass &set, std::vector<uint64_t> &bitmap) {
+        const char *data = str.data();
+        size_t len = str.size();
+        bitmap.assign((len + 63) / 64, 0);
+
+        size_t i = 0;
+        for (; i + 64 <= len; i += 64) {
+            bitmap[i / 64] = neonMovemask64(matchByteClassBlock_NEON(set, data + i), matchByteClassBlock_NEON(set, data + i + 16),
+                                            matchByteClassBlock_NEON(set, data + i + 32), matchByteClassBlock_NEON(set, data + i + 48));
+        }
+
+        for (; i < len; ++i) {
+            if (inByteClass(set, static_cast<unsigned char>(data[i]))) {
+                bitmap[i / 64] |= uint64_t(1) << (i % 64);
+            }
+        }
+    }
+#else
+    inline size_t findFirstOf_NEON(const std::string &str, const ByteClass &set, size_t pos = 0) {
+        return findFirstOf_Baseline(str, set, pos);
+    }
+
+    inline void matchByteClass_NEON(const std::string &str, const ByteClass &set, std::vector<uint64_t> &bitmap) {
+        matchByteClass_Baseline(str, set, bitmap);
+    }
+#endif
+
+    inline size_t findFirstOf(const std::string &str, const ByteClass &set, size_t pos = 0) {
+#if defined(__x86_64__) || defined(_M_X64)
+        static const bool use_avx2 = cpuSupportsAVX2();
+        return use_avx2 ? findFirstOf_AVX2(str, set, pos) : findFirstOf_Baseline(str, set, pos);
+#else
+        return findFirstOf_NEON(str, set, pos);
+#endif
+    }
+
+    inline void matchByteClass(const std::string &str, const ByteClass &set, std::vector<uint64_t> &bitmap) {
+#if defined(__x86_64__) || defined(_M_X64)
+        static const auto impl = cpuSupportsAVX2() ? matchByteClass_AVX2 : matchByteClass_Baseline;
+#else
+        static const auto impl = matchByteClass_NEON;
+#endif
+        impl(str, set, bitmap);
+    }
+
+    inline bool isLatin(const char *data, size_t len) {
+#if defined(__x86_64__) || defined(_M_X64)
+        static const auto impl = cpuSupportsAVX512BW() ? isLatin_AVX512
+                                 : cpuSupportsAVX2() ? isLatin_AVX2 : isLatin_SSE2;
+#elif defined(FURY_HAS_RVV)
+        static const auto impl = isLatin_RISCV;
+#else
+        static const auto impl = isLatin_NEON;
+#endif
+        return impl(data, len);
+    }
+
+    inline bool isLatin(const std::string &str) {
+        return isLatin(str.data(), str.size());
+    }
+
+    // ASCII case conversion from src to dst (which may be the same buffer); other bytes,
+    // including every byte of a multi-byte UTF-8 sequence, are copied unchanged
+    inline void toLowerAscii_Baseline(const char *src, char *dst, size_t len) {
+        for (size_t i = 0; i < len; ++i) {
+            char c = src[i];
+            dst[i] = c >= 'A' && c <= 'Z' ? static_cast<char>(c | 0x20) : c;
+        }
+    }
+
+    inline void toUpperAscii_Baseline(const char *src, char *dst, size_t len) {
+        for (size_t i = 0; i < len; ++i) {
+            char c = src[i];
+            dst[i] = c >= 'a' && c <= 'z' ? static_cast<char>(c & ~0x20) : c;
+        }
+    }
+
+    inline bool equalsIgnoreCaseAscii_Baseline(const char *a, const char *b, size_t len) {
+        for (size_t i = 0; i < len; ++i) {
+            char x = a[i] >= 'A' && a[i] <= 'Z' ? static_cast<char>(a[i] | 0x20) : a[i];
+            char y = b[i] >= 'A' && b[i] <= 'Z' ? static_cast<char>(b[i] | 0x20) : b[i];
+            if (x != y) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    inline bool equalsIgnoreCaseAscii_Baseline(const std::string &a, const std::string &b) {
+        return a.size() == b.size() && equalsIgnoreCaseAscii_Baseline(a.data(), b.data(), a.size());
+    }
+
+    inline uint64_t mixHashWord(uint64_t hash, uint64_t word) {
+        hash ^= word * 0x9E3779B97F4A7C15ULL;
+        hash = (hash << 31) | (hash >> 33);
+        return hash * 0xC2B2AE3D27D4EB4FULL;
+    }
+
+    inline uint64_t finishHash(uint64_t hash, size_t len) {
+        hash ^= len;
+        hash ^= hash >> 33;
+        hash *= 0xFF51AFD7ED558CCDULL;
+        hash ^= hash >> 33;
+        return hash;
+    }
+
+    // Hash of the lowercased bytes, mixed 8 bytes at a time; every variant gives the same value
+    inline uint64_t hashIgnoreCaseAscii_Baseline(const std::string &str) {
+        uint64_t hash = 0;
+        char folded[8];
+        for (size_t i = 0; i < str.size(); i += 8) {
+            size_t n = std::min<size_t>(8, str.size() - i);
+            std::fill(folded, folded + 8, 0);
+            toLowerAscii_Baseline(str.data() + i, folded, n);
+            uint64_t word;
+            std::memcpy(&word, folded, 8);
+            hash = mixHashWord(hash, word);
+        }
+        return finishHash(hash, str.size());
+    }
+
+#if defined(__x86_64__) || defined(_M_X64)
+    // Add 0x20 to the bytes in [first, last]; bytes >= 0x80 are negative and never match
+    FURY_TARGET_AVX2 inline __m256i flipCase_AVX2(__m256i chars, char first, char last) {
+        __m256i in_range = _mm256_and_si256(_mm256_cmpgt_epi8(chars, _mm256_set1_epi8(static_cast<char>(first - 1))),
+                                            _mm256_cmpgt_epi8(_mm256_set1_epi8(static_cast<char>(last + 1)), chars));
+        return _mm256_xor_si256(chars, _mm256_and_si256(in_range, _mm256_set1_epi8(0x20)));
+    }
+
+    FURY_TARGET_AVX2 inline void toLowerAscii_AVX2(const char *src, char *dst, size_t len) {
+        size_t i = 0;
+        for (; i + 32 <= len; i += 32) {
+            __m256i chars = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), flipCase_AVX2(chars, 'A', 'Z'));
+        }
+        toLowerAscii_Baseline(src + i, dst + i, len - i);
+    }
+
+    FURY_TARGET_AVX2 inline void toUpperAscii_AVX2(const char *src, char *dst, size_t len) {
+        size_t i = 0;
+        for (; i + 32 <= len; i += 32) {
+            __m256i chars = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), flipCase_AVX2(chars, 'a', 'z'));
+        }
+        toUpperAscii_Baseline(src + i, dst + i, len - i);
+    }
+
+    FURY_TARGET_AVX2 inline bool equalsIgnoreCaseAscii_AVX2(const std::string &a, const std::string &b) {
+        if (a.size() != b.size()) {
+            return false;
+        }
+        size_t len = a.size();
+        size_t i = 0;
+        for (; i + 32 <= len; i += 32) {
+            __m256i x = flipCase_AVX2(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(a.data() + i)), 'A', 'Z');
+            __m256i y = flipCase_AVX2(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(b.data() + i)), 'A', 'Z');
+            if (_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, y)) != -1) {
+                return false;
+            }
+        }
+        return equalsIgnoreCaseAscii_Baseline(a.data() + i, b.data() + i, len - i);
+    }
+
+    FURY_TARGET_AVX2 inline uint64_t hashIgnoreCaseAscii_AVX2(const std::string &str) {
+        uint64_t hash = 0;
+        size_t len = str.size();
+        size_t i = 0;
+        alignas(32) uint64_t words[4];
+        for (; i + 32 <= len; i += 32) {
+            __m256i chars = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(str.data() + i));
+            _mm256_store_si256(reinterpret_cast<__m256i *>(words), flipCase_AVX2(chars, 'A', 'Z'));
+            hash = mixHashWord(mixHashWord(mixHashWord(mixHashWord(hash, words[0]), words[1]), words[2]), words[3]);
+        }
+
+        char folded[8];
+        for (; i < len; i += 8) {
+            size_t n = std::min<size_t>(8, len - i);
+            std::fill(folded, folded + 8, 0);
+            toLowerAscii_Baseline(str.data() + i, folded, n);
+            uint64_t word;
+            std::memcpy(&word, folded, 8);
+            hash = mixHashWord(hash, word);
+        }
+        return finishHash(hash, len);
+    }
+#else
+    inline void toLowerAscii_AVX2(const char *src, char *dst, size_t len) {
+        toLowerAscii_Baseline(src, dst, len);
+    }
+
+    inline void toUpperAscii_AVX2(const char *src, char *dst, size_t len) {
+        toUpperAscii_Baseline(src, dst, len);
+    }
+
+    inline bool equalsIgnoreCaseAscii_AVX2(const std::string &a, const std::string &b) {
+        return equalsIgnoreCaseAscii_Baseline(a, b);
+    }
+
+    inline uint64_t hashIgnoreCaseAscii_AVX2(const std::string &str) {
+        return hashIgnoreCaseAscii_Baseline(str);
+    }
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    inline uint8x16_t flipCase_NEON(uint8x16_t chars, uint8_t first, uint8_t last) {
+        uint8x16_t in_range = vandq_u8(vcgeq_u8(chars, vdupq_n_u8(first)), vcleq_u8(chars, vdupq_n_u8(last)));
+        return veorq_u8(chars, vandq_u8(in_range, vdupq_n_u8(0x20)));
+    }
+
+    inline void toLowerAscii_NEON(const char *src, char *dst, size_t len) {
+        size_t i = 0;
+        for (; i + 16 <= len; i += 16) {
+            uint8x16_t chars = vld1q_u8(reinterpret_cast<const uint8_t *>(src + i));
+            vst1q_u8(reinterpret_cast<uint8_t *>(dst + i), flipCase_NEON(chars, 'A', 'Z'));
+        }
+        toLowerAscii_Baseline(src + i, dst + i, len - i);
+    }
+
+    inline void toUpperAscii_NEON(const char *src, char *dst, size_t len) {
+        size_t i = 0;
+        for (; i + 16 <= len; i += 16) {
+            uint8x16_t chars = vld1q_u8(reinterpret_cast<const uint8_t *>(src + i));
+            vst1q_u8(reinterpret_cast<uint8_t *>(dst + i), flipCase_NEON(chars, 'a', 'z'));
+        }
+        toUpperAscii_Baseline(src + i, dst + i, len - i);
+    }
+
+    inline bool equalsIgnoreCaseAscii_NEON(const std::string &a, const std::string &b) {
+        if (a.size() != b.size()) {
+            return false;
+        }
+        size_t len = a.size();
+        size_t i = 0;
+        for (; i + 16 <= len; i += 16) {
+            uint8x16_t x = flipCase_NEON(vld1q_u8(reinterpret_cast<const uint8_t *>(a.data() + i)), 'A', 'Z');
+            uint8x16_t y = flipCase_NEON(vld1q_u8(reinterpret_cast<const uint8_t *>(b.data() + i)), 'A', 'Z');
+            if (vminvq_u8(vceqq_u8(x, y)) == 0) {
+                return false;
+            }
+        }
+        return equalsIgnoreCaseAscii_Baseline(a.data() + i, b.data() + i, len - i);
+    }
+#else
+    inline void toLowerAscii_NEON(const char *src, char *dst, size_t len) {
+        toLowerAscii_Baseline(src, dst, len);
+    }
+
+    inline void toUpperAscii_NEON(const char *src, char *dst, size_t len) {
+        toUpperAscii_Baseline(src, dst, len);
+    }
+
+    inline bool equalsIgnoreCaseAscii_NEON(const std::string &a, const std::string &b) {
+        return equalsIgnoreCaseAscii_Baseline(a, b);
+    }
+#endif
+
+    inline void toLowerAscii(const char *src, char *dst, size_t len) {
+#if defined(__x86_64__) || defined(_M_X64)
+        static const auto impl = cpuSupportsAVX2() ? toLowerAscii_AVX2 : toLowerAscii_Baseline;
+#else
+        static const auto impl = toLowerAscii_NEON;
+#endif
+        impl(src, dst, len);
+    }
+
+    inline void toUpperAscii(const char *src, char *dst, size_t len) {
+#if defined(__x86_64__) || defined(_M_X64)
+        static const auto impl = cpuSupportsAVX2() ? toUpperAscii_AVX2 : toUpperAscii_Baseline;
+#else
+        static const auto impl = toUpperAscii_NEON;
+#endif
+        impl(src, dst, len);
+    }
+
+    inline void toLowerAscii(std::string &str) {
+        toLowerAscii(str.data(), &str[0], str.size());
+    }
+
+    inline void toUpperAscii(std::string &str) {
+        toUpperAscii(str.data(), &str[0], str.size());
+    }
+
+    inline std::string toLowerAsciiCopy(const std::string &str) {
+        std::string result(str.size(), '\0');
+        toLowerAscii(str.data(), &result[0], str.size());
+        return result;
+    }
+
+    inline std::string toUpperAsciiCopy(const std::string &str) {
+        std::string result(str.size(), '\0');
+        toUpperAscii(str.data(), &result[0], str.size());
+        return result;
+    }
+
+    inline bool equalsIgnoreCaseAscii(const std::string &a, const std::string &b) {
+#if defined(__x86_64__) || defined(_M_X64)
+        // The Baseline name is overloaded with the pointer core, so the string form is picked out
+        using Kernel = bool (*)(const std::string &, const std::string &);
+        static const Kernel impl = cpuSupportsAVX2() ? equalsIgnoreCaseAscii_AVX2 : Kernel(equalsIgnoreCaseAscii_Baseline);
+#else
+        static const auto impl = equalsIgnoreCaseAscii_NEON;
+#endif
+        return impl(a, b);
+    }
+
+    inline uint64_t hashIgnoreCaseAscii(const std::string &str) {
+#if defined(__x86_64__) || defined(_M_X64)
+        static const auto impl = cpuSupportsAVX2() ? hashIgnoreCaseAscii_AVX2 : hashIgnoreCaseAscii_Baseline;
+#else
+        static const auto impl = hashIgnoreCaseAscii_Baseline;
+#endif
+        return impl(str);
+    }
+
+    // Lowercase UTF-8 text for caseless matching: ASCII letters plus the Latin-1 letters
+    // U+00C0..U+00DE (except the multiplication sign), which are 0xC3 0x80..0x9E in UTF-8
+    inline std::string foldLatin1Utf8(const std::string &str) {
+        std::string folded = toLowerAsciiCopy(str);
+        for (size_t i = 0; i + 1 < folded.size(); ++i) {
+            unsigned char lead = static_cast<unsigned char>(folded[i]);
+            unsigned char next = static_cast<unsigned char>(folded[i + 1]);
+            if (lead == 0xC3 && next >= 0x80 && next <= 0x9E && next != 0x97) {
+                folded[++i] = static_cast<char>(next + 0x20);
+            }
+        }
+        return folded;
+    }
+
+    // Caseless equality and hash for UTF-8 keys. ASCII-only input, the common case for
+    // header names and keywords, is settled by the vector kernels alone; anything else is
+    // Latin-1 folded first, so equal keys always hash alike.
+    inline bool equalsIgnoreCase(const std::string &a, const std::string &b) {
+        if (a.size() != b.size()) {
+            return false;
+        }
+        if (isLatin(a) && isLatin(b)) {
+            return equalsIgnoreCaseAscii(a, b);
+        }
+        return foldLatin1Utf8(a) == foldLatin1Utf8(b);
+    }
+
+    inline uint64_t hashIgnoreCase(const std::string &str) {
+        if (isLatin(str)) {
+            return hashIgnoreCaseAscii(str);
+        }
+        return hashIgnoreCaseAscii(foldLatin1Utf8(str));
+    }
+
+    // Apache Fury MetaString: type, field and package names packed into 5 or 6 bits per character.
+    // The packed bytes are a most-significant-bit-first stream whose first bit is set when the
+    // padding at the end could be misread as one more character.
+    enum class MetaStringEncoding : uint8_t {
+        UTF_8 = 0,
+        LOWER_SPECIAL = 1,             // a-z . _ $ | in 5 bits
+        LOWER_UPPER_DIGIT_SPECIAL = 2, // a-z A-Z 0-9 and two special characters in 6 bits
+        FIRST_TO_LOWER_SPECIAL = 3,    // LOWER_SPECIAL with the first character lowercased
+        ALL_TO_LOWER_SPECIAL = 4,      // LOWER_SPECIAL with every upper X written as |x
+    };
+
+    struct MetaString {
+        MetaStringEncoding encoding;
+        std::string bytes;
+    };
+
+    // Character statistics that decide the encoding, gathered in one pass
+    struct MetaStringStats {
+        bool can_lower_special;               // only a-z . _ $ |
+        bool can_lower_special_ignoring_case; // only a-z A-Z . _ $ |
+        bool can_lower_upper_digit_special;   // only a-z A-Z 0-9 special1 special2
+        size_t digit_count;
+        size_t upper_count;
+    };
+
+    inline MetaStringStats computeMetaStringStats_Baseline(const char *data, size_t len, char special1, char special2) {
+        MetaStringStats stats = {true, true, true, 0, 0};
+        for (size_t i = 0; i < len; ++i) {
+            char c = data[i];
+            bool lower = c >= 'a' && c <= 'z';
+            bool upper = c >= 'A' && c <= 'Z';
+            bool digit = c >= '0' && c <= '9';
+            bool special = c == '.' || c == '_' || c == '$' || c == '|';
+            stats.can_lower_special &= lower || special;
+            stats.can_lower_special_ignoring_case &= lower || upper || special;
+            stats.can_lower_upper_digit_special &= lower || upper || digit || c == special1 || c == special2;
+            stats.digit_count += digit;
+            stats.upper_count += upper;
+        }
+        return stats;
+    }
+
+    inline uint8_t metaCharToValue(char c, int bits, char special1, char special2) {
+        if (c >= 'a' && c <= 'z') {
+            return static_cast<uint8_t>(c - 'a');
+        }
+        if (bits == 5) {
+            switch (c) {
+                case '.': return 26;
+                case '_': return 27;
+                case '$': return 28;
+                case '|': return 29;
+                default: break;
+            }
+        } else {
+            if (c >= 'A' && c <= 'Z') {
+                return static_cast<uint8_t>(c - 'A' + 26);
+            }
+            if (c >= '0' && c <= '9') {
+                return static_cast<uint8_t>(c - '0' + 52);
+            }
+            if (c == special1) {
+                return 62;
+            }
+            if (c == special2) {
+                return 63;
+            }
+        }
+        throw std::invalid_argument("Unsupported character for MetaString encoding");
+    }
+
+    inline char metaValueToChar(uint8_t value, int bits, char special1, char special2) {
+        if (value < 26) {
+            return static_cast<char>('a' + value);
+        }
+        if (bits == 5) {
+            static const char specials[] = {'.', '_', '$', '|'};
+            if (value < 30) {
+                return specials[value - 26];
+            }
+        } else {
+            if (value < 52) {
+                return static_cast<char>('A' + value - 26);
+            }
+            if (value < 62) {
+                return static_cast<char>('0' + value - 52);
+            }
+            return value == 62 ? special1 : special2;
+        }
+        throw std::invalid_argument("Invalid MetaString character value");
+    }
+
+    // Pack the characters as bits-wide values into a bit stream starting at out[0]
+    inline void packMetaChars_Baseline(const char *data, size_t len, int bits, char special1, char special2, uint8_t *out) {
+        uint32_t acc = 0;
+        int acc_bits = 0;
+        for (size_t i = 0; i < len; ++i) {
+            acc = (acc << bits) | metaCharToValue(data[i], bits, special1, special2);
+            acc_bits += bits;
+            if (acc_bits >= 8) {
+                acc_bits -= 8;
+                *out++ = static_cast<uint8_t>(acc >> acc_bits);
+                acc &= (1u << acc_bits) - 1;
+            }
+        }
+        if (acc_bits > 0) {
+            *out = static_cast<uint8_t>(acc << (8 - acc_bits));
+        }
+    }
+
+    // Read count bits-wide values from a bit stream starting at bytes[0]
+    inline void unpackMetaValues_Baseline(const uint8_t *bytes, size_t count, int bits, uint8_t *values) {
+        uint32_t acc = 0;
+        int acc_bits = 0;
+        for (size_t i = 0; i < count; ++i) {
+            if (acc_bits < bits) {
+                acc = (acc << 8) | *bytes++;
+                acc_bits += 8;
+            }
+            acc_bits -= bits;
+            values[i] = static_cast<uint8_t>((acc >> acc_bits) & ((1u << bits) - 1));
+            acc &= (1u << acc_bits) - 1;
+        }
+    }
+
+#if defined(__x86_64__) || defined(_M_X64)
+    FURY_TARGET_AVX2 inline __m256i inRange_AVX2(__m256i chars, char first, char last) {
+        return _mm256_and_si256(_mm256_cmpgt_epi8(chars, _mm256_set1_epi8(static_cast<char>(first - 1))),
+                                _mm256_cmpgt_epi8(_mm256_set1_epi8(static_cast<char>(last + 1)), chars));
+    }
+
+    FURY_TARGET_AVX2 inline __m256i equals_AVX2(__m256i chars, char c) {
+        return _mm256_cmpeq_epi8(chars, _mm256_set1_epi8(c));
+    }
+
+    FURY_TARGET_AVX2 inline MetaStringStats computeMetaStringStats_AVX2(const char *data, size_t len, char special1, char special2) {
+        uint32_t not_lower_special = 0;
+        uint32_t not_lower_special_ignoring_case = 0;
+        uint32_t not_lower_upper_digit_special = 0;
+        size_t digit_count = 0;
+        size_t upper_count = 0;
+        size_t i = 0;
+        for (; i + 32 <= len; i += 32) {
+            __m256i chars = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+            __m256i lower = inRange_AVX2(chars, 'a', 'z');
+            __m256i upper = inRange_AVX2(chars, 'A', 'Z');
+            __m256i digit = inRange_AVX2(chars, '0', '9');
+            __m256i special = _mm256_or_si256(_mm256_or_si256(equals_AVX2(chars, '.'), equals_AVX2(chars, '_')),
+                                              _mm256_or_si256(equals_AVX2(chars, '$'), equals_AVX2(chars, '|')));
+            __m256i lower_special = _mm256_or_si256(lower, special);
+            __m256i letters_digits = _mm256_or_si256(_mm256_or_si256(lower, upper), digit);
+            __m256i user_special = _mm256_or_si256(equals_AVX2(chars, special1), equals_AVX2(chars, special2));
+
+            not_lower_special |= ~static_cast<uint32_t>(_mm256_movemask_epi8(lower_special));
+            not_lower_special_ignoring_case |= ~static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_or_si256(lower_special, upper)));
+            not_lower_upper_digit_special |= ~static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_or_si256(letters_digits, user_special)));
+            digit_count += popCount(static_cast<uint32_t>(_mm256_movemask_epi8(digit)));
+            upper_count += popCount(static_cast<uint32_t>(_mm256_movemask_epi8(upper)));
+        }
+
+        MetaStringStats stats = computeMetaStringStats_Baseline(data + i, len - i, special1, special2);
+        stats.can_lower_special &= not_lower_special == 0;
+        stats.can_lower_special_ignoring_case &= not_lower_special_ignoring_case == 0;
+        stats.can_lower_upper_digit_special &= not_lower_upper_digit_special == 0;
+        stats.digit_count += digit_count;
+        stats.upper_count += upper_count;
+        return stats;
+    }
+
+    // Map 16 characters to their 5- or 6-bit values and pack them MSB first into 10 or 12
+    // bytes: maddubs merges pairs, madd merges pairs of pairs, and one shuffle writes the
+    // resulting 20- or 24-bit groups out big endian
+    FURY_TARGET_AVX2 inline void packMetaChars_AVX2(const char *data, size_t len, int bits, char special1, char special2, uint8_t *out) {
+        size_t i = 0;
+        for (; i + 16 <= len; i += 16) {
+            __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+            __m128i values = _mm_sub_epi8(c, _mm_set1_epi8('a'));
+            __m128i packed;
+            if (bits == 5) {
+                values = _mm_blendv_epi8(values, _mm_set1_epi8(26), _mm_cmpeq_epi8(c, _mm_set1_epi8('.')));
+                values = _mm_blendv_epi8(values, _mm_set1_epi8(27), _mm_cmpeq_epi8(c, _mm_set1_epi8('_')));
+                values = _mm_blendv_epi8(values, _mm_set1_epi8(28), _mm_cmpeq_epi8(c, _mm_set1_epi8('$')));
+                values = _mm_blendv_epi8(values, _mm_set1_epi8(29), _mm_cmpeq_epi8(c, _mm_set1_epi8('|')));
+
+                __m128i pairs = _mm_maddubs_epi16(values, _mm_set1_epi16(0x0120));  // v0 * 32 + v1
+                __m128i quads = _mm_madd_epi16(pairs, _mm_set1_epi32(0x00010400));  // p0 * 1024 + p1
+                // Join the two 20-bit groups of each 64-bit lane into 40 bits
+                __m128i groups = _mm_or_si128(_mm_slli_epi64(quads, 20), _mm_srli_epi64(quads, 32));
+                packed = _mm_shuffle_epi8(groups, _mm_setr_epi8(4, 3, 2, 1, 0, 12, 11, 10, 9, 8, -1, -1, -1, -1, -1, -1));
+            } else {
+                __m128i upper = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('A' - 1)), _mm_cmpgt_epi8(_mm_set1_epi8('Z' + 1), c));
+                __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(c, _mm_set1_epi8('0' - 1)), _mm_cmpgt_epi8(_mm_set1_epi8('9' + 1), c));
+                values = _mm_blendv_epi8(values, _mm_sub_epi8(c, _mm_set1_epi8('A' - 26)), upper);
+                values = _mm_blendv_epi8(values, _mm_sub_epi8(c, _mm_set1_epi8('0' - 52)), digit);
+                values = _mm_blendv_epi8(values, _mm_set1_epi8(62), _mm_cmpeq_epi8(c, _mm_set1_epi8(special1)));
+                values = _mm_blendv_epi8(values, _mm_set1_epi8(63), _mm_cmpeq_epi8(c, _mm_set1_epi8(special2)));
+
+                __m128i pairs = _mm_maddubs_epi16(values, _mm_set1_epi16(0x0140));  // v0 * 64 + v1
+                __m128i quads = _mm_madd_epi16(pairs, _mm_set1_epi32(0x00011000));  // p0 * 4096 + p1
+                packed = _mm_shuffle_epi8(quads, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+            }
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out), packed);
+            out += bits * 2;
+        }
+
+        packMetaChars_Baseline(data + i, len - i, bits, special1, special2, out);
+    }
+
+    // Unpack 8 values per step: every 32-bit lane gets the two bytes its value straddles,
+    // then a per-lane variable shift and mask isolate it
+    FURY_TARGET_AVX2 inline void unpackMetaValues_AVX2(const uint8_t *bytes, size_t count, int bits, uint8_t *values) {
+        alignas(32) int8_t shuffle[32];
+        alignas(32) int32_t shifts[8];
+        for (int k = 0; k < 8; ++k) {
+            int offset = k * bits;
+            int8_t *lane = shuffle + (k / 4) * 16 + (k % 4) * 4;
+            lane[0] = static_cast<int8_t>(offset / 8 + 1);
+            lane[1] = static_cast<int8_t>(offset / 8);
+            lane[2] = lane[3] = -1;
+            shifts[k] = 16 - offset % 8 - bits;
+        }
+        const __m256i shuffle_mask = _mm256_load_si256(reinterpret_cast<const __m256i *>(shuffle));
+        const __m256i shift_counts = _mm256_load_si256(reinterpret_cast<const __m256i *>(shifts));
+        const __m256i value_mask = _mm256_set1_epi32((1 << bits) - 1);
+        const __m256i gather = _mm256_setr_epi32(0, 4, 0, 0, 0, 0, 0, 0);
+
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8) {
+            // The caller leaves 16 readable bytes past the stream
+            __m256i in = _mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(bytes)));
+            __m256i lanes = _mm256_and_si256(_mm256_srlv_epi32(_mm256_shuffle_epi8(in, shuffle_mask), shift_counts), value_mask);
+            __m256i narrowed = _mm256_packus_epi16(_mm256_packus_epi32(lanes, lanes), _mm256_setzero_si256());
+            _mm_storel_epi64(reinterpret_cast<__m128i *>(values + i),
+                             _mm256_castsi256_si128(_mm256_permutevar8x32_epi32(narrowed, gather)));
+            bytes += bits;
+        }
+
+        unpackMetaValues_Baseline(bytes, count - i, bits, values + i);
+    }
+#else
+    inline MetaStringStats computeMetaStringStats_AVX2(const char *data, size_t len, char special1, char special2) {
+        return computeMetaStringStats_Baseline(data, len, special1, special2);
+    }
+
+    inline void packMetaChars_AVX2(const char *data, size_t len, int bits, char special1, char special2, uint8_t *out) {
+        packMetaChars_Baseline(data, len, bits, special1, special2, out);
+    }
+
+    inline void unpackMetaValues_AVX2(const uint8_t *bytes, size_t count, int bits, uint8_t *values) {
+        unpackMetaValues_Baseline(bytes, count, bits, values);
+    }
+#endif
+
+    // Move a big-endian bit stream of len bytes one bit towards the end (right) or the start
+    // (left), eight bytes at a time
+    inline void shiftBitsRight(uint8_t *bytes, size_t len) {
+        uint64_t carry = 0;
+        size_t i = 0;
+        for (; i + 8 <= len; i += 8) {
+            uint64_t word;
+            std::memcpy(&word, bytes + i, 8);
+            word = byteSwap64(word);
+            uint64_t shifted = byteSwap64((word >> 1) | (carry << 63));
+            carry = word & 1;
+            std::memcpy(bytes + i, &shifted, 8);
+        }
+        for (; i < len; ++i) {
+            uint8_t byte = bytes[i];
+            bytes[i] = static_cast<uint8_t>((byte >> 1) | (carry << 7));
+            carry = byte & 1;
+        }
+    }
+
+    inline void shiftBitsLeft(uint8_t *bytes, size_t len) {
+        size_t i = 0;
+        for (; i + 8 < len; i += 8) {
+            uint64_t word;
+            std::memcpy(&word, bytes + i, 8);
+            uint64_t shifted = byteSwap64((byteSwap64(word) << 1) | (bytes[i + 8] >> 7));
+            std::memcpy(bytes + i, &shifted, 8);
+        }
+        for (; i < len; ++i) {
+            uint8_t next = i + 1 < len ? bytes[i + 1] : 0;
+            bytes[i] = static_cast<uint8_t>((bytes[i] << 1) | (next >> 7));
+        }
+    }
+
+    inline MetaStringStats computeMetaStringStats(const std::string &str, char special1, char special2) {
+#if defined(__x86_64__) || defined(_M_X64)
+        static const auto impl = cpuSupportsAVX2() ? computeMetaStringStats_AVX2 : computeMetaStringStats_Baseline;
+#else
+        static const auto impl = computeMetaStringStats_Baseline;
+#endif
+        return impl(str.data(), str.size(), special1, special2);
+    }
+
+    // Same choice as Fury's MetaStringEncoder.computeEncoding with every encoding allowed
+    inline MetaStringEncoding chooseMetaStringEncoding(const std::string &str, const MetaStringStats &stats) {
+        if (stats.can_lower_special) {
+            return MetaStringEncoding::LOWER_SPECIAL;
+        }
+        if (stats.can_lower_upper_digit_special) {
+            if (stats.digit_count != 0) {
+                return MetaStringEncoding::LOWER_UPPER_DIGIT_SPECIAL;
+            }
+            if (stats.can_lower_special_ignoring_case) {
+                if (stats.upper_count == 1 && str[0] >= 'A' && str[0] <= 'Z') {
+                    return MetaStringEncoding::FIRST_TO_LOWER_SPECIAL;
+                }
+                if ((str.size() + stats.upper_count) * 5 < str.size() * 6) {
+                    return MetaStringEncoding::ALL_TO_LOWER_SPECIAL;
+                }
+            }
+            return MetaStringEncoding::LOWER_UPPER_DIGIT_SPECIAL;
+        }
+        return MetaStringEncoding::UTF_8;
+    }
+
+    inline MetaString encodeMetaString(const std::string &input, char special1 = '.', char special2 = '_') {
+        MetaString meta;
+        meta.encoding = MetaStringEncoding::LOWER_SPECIAL;
+        if (input.empty()) {
+            return meta;
+        }
+
+        meta.encoding = chooseMetaStringEncoding(input, computeMetaStringStats(input, special1, special2));
+        // Only ALL_TO_LOWER_SPECIAL changes the length; the other encodings pack the input
+        // itself, and FIRST_TO_LOWER_SPECIAL packs a lowered copy of its first 8 characters,
+        // which fill exactly 5 bytes
+        std::string chars;
+        const char *data = input.data();
+        size_t size = input.size();
+        switch (meta.encoding) {
+            case MetaStringEncoding::UTF_8:
+                meta.bytes = input;
+                return meta;
+            case MetaStringEncoding::FIRST_TO_LOWER_SPECIAL:
+                chars.assign(input, 0, 8);
+                chars[0] = static_cast<char>(chars[0] | 0x20);
+                break;
+            case MetaStringEncoding::ALL_TO_LOWER_SPECIAL:
+                chars.reserve(input.size() * 2);
+                for (char c : input) {
+                    if (c >= 'A' && c <= 'Z') {
+                        chars += '|';
+                        c = static_cast<char>(c | 0x20);
+                    }
+                    chars += c;
+                }
+                data = chars.data();
+                size = chars.size();
+                break;
+            default:
+                break;
+        }
+
+        int bits = meta.encoding == MetaStringEncoding::LOWER_UPPER_DIGIT_SPECIAL ? 6 : 5;
+        size_t total_bits = size * bits + 1;
+        size_t length = (total_bits + 7) / 8;
+        meta.bytes.assign(length + 16, '\0'); // Room for the 16-byte vector stores
+        uint8_t *out = reinterpret_cast<uint8_t *>(&meta.bytes[0]);
+#if defined(__x86_64__) || defined(_M_X64)
+        static const auto pack = cpuSupportsAVX2() ? packMetaChars_AVX2 : packMetaChars_Baseline;
+#else
+        static const auto pack = packMetaChars_Baseline;
+#endif
+        if (meta.encoding == MetaStringEncoding::FIRST_TO_LOWER_SPECIAL) {
+            pack(chars.data(), chars.size(), bits, special1, special2, out);
+            if (size > 8) {
+                pack(data + 8, size - 8, bits, special1, special2, out + 5);
+            }
+        } else {
+            pack(data, size, bits, special1, special2, out);
+        }
+        shiftBitsRight(out, length);
+        if (length * 8 >= total_bits + bits) {
+            out[0] |= 0x80; // The padding could hold one more character
+        }
+        meta.bytes.resize(length);
+        return meta;
+    }
+
+    inline std::string decodeMetaString(const MetaString &meta, char special1 = '.', char special2 = '_') {
+        if (meta.encoding == MetaStringEncoding::UTF_8 || meta.bytes.empty()) {
+            return meta.bytes;
+        }
+
+        int bits = meta.encoding == MetaStringEncoding::LOWER_UPPER_DIGIT_SPECIAL ? 6 : 5;
+        size_t total_bits = meta.bytes.size() * 8;
+        bool strip_last_char = (static_cast<uint8_t>(meta.bytes[0]) & 0x80) != 0;
+        size_t count = (total_bits - 1) / bits - strip_last_char;
+
+        std::vector<uint8_t> stream(meta.bytes.begin(), meta.bytes.end());
+        stream.resize(meta.bytes.size() + 16);
+        shiftBitsLeft(stream.data(), meta.bytes.size());
+
+        std::vector<uint8_t> values(count);
+#if defined(__x86_64__) || defined(_M_X64)
+        static const auto unpack = cpuSupportsAVX2() ? unpackMetaValues_AVX2 : unpackMetaValues_Baseline;
+#else
+        static const auto unpack = unpackMetaValues_Baseline;
+#endif
+        unpack(stream.data(), count, bits, values.data());
+
+        std::string decoded;
+        decoded.reserve(count);
+        for (size_t i = 0; i < count; ++i) {
+            char c = metaValueToChar(values[i], bits, special1, special2);
+            if (meta.encoding == MetaStringEncoding::ALL_TO_LOWER_SPECIAL && c == '|' && i + 1 < count) {
+                c = static_cast<char>(metaValueToChar(values[++i], bits, special1, special2) & ~0x20);
+            }
+            decoded += c;
+        }
+        if (meta.encoding == MetaStringEncoding::FIRST_TO_LOWER_SPECIAL && !decoded.empty()) {
+            decoded[0] = static_cast<char>(decoded[0] & ~0x20);
+        }
+        return decoded;
+    }
+
+    // Fury varints: 7 bits per byte, least significant group first, high bit set on every byte
+    // but the last. Unlike LEB128, a varuint64 stops at 9 bytes: after 8 bytes carrying 56 bits
+    // the 9th holds the remaining 8 bits whole, with no continuation flag. Signed values are
+    // zigzag encoded first.
+    inline uint32_t encodeZigZag32(int32_t value) {
+        return (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+    }
+
+    inline int32_t decodeZigZag32(uint32_t value) {
+        return static_cast<int32_t>((value >> 1) ^ (~(value & 1) + 1));
+    }
+
+    inline uint64_t encodeZigZag64(int64_t value) {
+        return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+    }
+
+    inline int64_t decodeZigZag64(uint64_t value) {
+        return static_cast<int64_t>((value >> 1) ^ (~(value & 1) + 1));
+    }
+
+    // Write one varint with a single 8-byte store: the 7-bit groups are spread to byte
+    // boundaries with shifts (SWAR) and the continuation bits ORed in, so there is no
+    // per-byte branch. out needs 8 writable bytes (9 for 64-bit values from 2^56 up).
+    inline uint8_t *writeVarUint32(uint32_t value, uint8_t *out) {
+        int len = 1 + (value >= (1u << 7)) + (value >= (1u << 14)) + (value >= (1u << 21)) + (value >= (1u << 28));
+        uint64_t spread = (value & 0x7F) | (uint64_t(value & 0x3F80) << 1) | (uint64_t(value & 0x1FC000) << 2) |
+                          (uint64_t(value & 0xFE00000) << 3) | (uint64_t(value & 0xF0000000) << 4);
+        spread |= 0x8080808080ULL & ((uint64_t(1) << ((len - 1) * 8)) - 1);
+        std::memcpy(out, &spread, 8);
+        return out + len;
+    }
+
+    inline uint8_t *writeVarUint64(uint64_t value, uint8_t *out) {
+        if (value < (uint64_t(1) << 28)) {
+            return writeVarUint32(static_cast<uint32_t>(value), out);
+        }
+        uint64_t spread = 0;
+        for (int group = 0; group < 8; ++group) {
+            spread |= ((value >> (7 * group)) & 0x7F) << (8 * group);
+        }
+        if (value >= (uint64_t(1) << 56)) {
+            spread |= 0x8080808080808080ULL;
+            std::memcpy(out, &spread, 8);
+            out[8] = static_cast<uint8_t>(value >> 56);
+            return out + 9;
+        }
+        int len = 5;
+        while ((value >> (7 * len)) != 0) {
+            ++len;
+        }
+        spread |= 0x8080808080808080ULL & ((uint64_t(1) << ((len - 1) * 8)) - 1);
+        std::memcpy(out, &spread, 8);
+        return out + len;
+    }
+
+    // Scalar SWAR decoding, for when 8 bytes are readable: one 8-byte load, the length from
+    // the first byte whose high bit is clear (one count of trailing zeros instead of a branch
+    // per byte), and three shift-and-mask steps that pack the 7-bit groups together.
+    // Returns the length of the varint in the bytes of word, or 0 when all 8 have the high bit.
+    inline int varintLength(uint64_t word) {
+        uint64_t stops = ~word & 0x8080808080808080ULL;
+        return stops == 0 ? 0 : countTrailingZeros64(stops) / 8 + 1;
+    }
+
+    // The first len bytes of word as a varint value, least significant group first
+    inline uint64_t packVarintGroups(uint64_t word, int len) {
+        uint64_t groups = word & 0x7F7F7F7F7F7F7F7FULL;
+        if (len < 8) {
+            groups &= (uint64_t(1) << (len * 8)) - 1;
+        }
+        groups = (groups & 0x007F007F007F007FULL) | ((groups & 0x7F007F007F007F00ULL) >> 1);
+        groups = (groups & 0x00003FFF00003FFFULL) | ((groups & 0x3FFF00003FFF0000ULL) >> 2);
+        return (groups & 0x000000000FFFFFFFULL) | ((groups & 0x0FFFFFFF00000000ULL) >> 4);
+    }
+
+    inline const uint8_t *readVarUint32(const uint8_t *in, const uint8_t *end, uint32_t &value) {
+        // A run of 1-byte values is predicted well and keeps the next address independent of
+        // the loaded data, which the SWAR length is not
+        if (in != end && *in < 0x80) {
+            value = *in;
+            return in + 1;
+        }
+        if (end - in >= 8) {
+            uint64_t word;
+            std::memcpy(&word, in, 8);
+            int len = varintLength(word);
+            if (len == 0 || len > 5) {
+                throw std::runtime_error("Malformed varint");
+            }
+            value = static_cast<uint32_t>(packVarintGroups(word, len));
+            return in + len;
+        }
+
+        // The last few bytes of the input, one at a time
+        uint32_t result = 0;
+        for (int shift = 0; shift < 35; shift += 7) {
+            if (in == end) {
+                throw std::runtime_error("Truncated varint");
+            }
+            uint8_t byte = *in++;
+            result |= uint32_t(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) {
+                value = result;
+                return in;
+            }
+        }
+        throw std::runtime_error("Malformed varint");
+    }
+
+    inline const uint8_t *readVarUint64(const uint8_t *in, const uint8_t *end, uint64_t &value) {
+        if (in != end && *in < 0x80) {
+            value = *in;
+            return in + 1;
+        }
+        if (end - in >= 9) {
+            uint64_t word;
+            std::memcpy(&word, in, 8);
+            int len = varintLength(word);
+            if (len != 0) {
+                value = packVarintGroups(word, len);
+                return in + len;
+            }
+            value = packVarintGroups(word, 8) | uint64_t(in[8]) << 56;
+            return in + 9;
+        }
+
+        // The last few bytes of the input, one at a time
+        uint64_t result = 0;
+        for (int shift = 0; shift < 56; shift += 7) {
+            if (in == end) {
+                throw std::runtime_error("Truncated varint");
+            }
+            uint8_t byte = *in++;
+            result |= uint64_t(byte & 0x7F) << shift;
+            if ((byte & 0x80) == 0) {
+                value = result;
+                return in;
+            }
+        }
+        // Eight bytes with the high bit set: the 9th is the top 8 bits, all of it value
+        if (in == end) {
+            throw std::runtime_error("Truncated varint");
+        }
+        value = result | uint64_t(*in++) << 56;
+        return in;
+    }
+
+    // Encode count values and return the number of bytes written. out needs count * 5 + 8
+    // bytes (count * 9 + 8 for 64-bit values).
+    inline size_t encodeVarUint32Batch(const uint32_t *values, size_t count, uint8_t *out) {
+        uint8_t *start = out;
+        for (size_t i = 0; i < count; ++i) {
+            out = writeVarUint32(values[i], out);
+        }
+        return out - start;
+    }
+
+    inline size_t encodeVarUint64Batch(const uint64_t *values, size_t count, uint8_t *out) {
+        uint8_t *start = out;
+        for (size_t i = 0; i < count; ++i) {
+            out = writeVarUint64(values[i], out);
+        }
+        return out - start;
+    }
+
+    inline size_t encodeVarInt32Batch(const int32_t *values, size_t count, uint8_t *out) {
+        uint8_t *start = out;
+        for (size_t i = 0; i < count; ++i) {
+            out = writeVarUint32(encodeZigZag32(values[i]), out);
+        }
+        return out - start;
+    }
+
+    inline size_t encodeVarInt64Batch(const int64_t *values, size_t count, uint8_t *out) {
+        uint8_t *start = out;
+        for (size_t i = 0; i < count; ++i) {
+            out = writeVarUint64(encodeZigZag64(values[i]), out);
+        }
+        return out - start;
+    }
+
+    // Decode count values from the len bytes at in and return the number of bytes consumed
+    // Every varint that ends in one 8-byte load is unpacked from it, so the next load waits on
+    // one count of trailing zeros per word rather than per value; eight 1-byte values are just
+    // widened. A varint running past the word is picked up by the next load, which starts there.
+    inline size_t decodeVarUint32Batch_Baseline(const uint8_t *in, size_t len, uint32_t *values, size_t count) {
+        const uint8_t *start = in;
+        const uint8_t *end = in + len;
+        size_t i = 0;
+        while (i < count && end - in >= 8) {
+            uint64_t word;
+            std::memcpy(&word, in, 8);
+            if ((word & 0x8080808080808080ULL) == 0) {
+                size_t n = std::min<size_t>(8, count - i);
+                for (size_t k = 0; k < n; ++k) {
+                    values[i + k] = in[k];
+                }
+                i += n;
+                in += n;
+                continue;
+            }
+            uint64_t stops = ~word & 0x8080808080808080ULL;
+            if (stops == 0) {
+                throw std::runtime_error("Malformed varint");
+            }
+            int used = 0;
+            while (stops != 0 && i < count) {
+                int next = countTrailingZeros64(stops) / 8 + 1;
+                if (next - used > 5) {
+                    throw std::runtime_error("Malformed varint");
+                }
+                values[i++] = static_cast<uint32_t>(packVarintGroups(word >> (used * 8), next - used));
+                used = next;
+                stops &= stops - 1;
+            }
+            in += used;
+        }
+        for (; i < count; ++i) {
+            in = readVarUint32(in, end, values[i]);
+        }
+        return in - start;
+    }
+
+    inline size_t decodeVarUint64Batch_Baseline(const uint8_t *in, size_t len, uint64_t *values, size_t count) {
+        const uint8_t *start = in;
+        const uint8_t *end = in + len;
+        size_t i = 0;
+        while (i < count && end - in >= 9) {
+            uint64_t word;
+            std::memcpy(&word, in, 8);
+            if ((word & 0x8080808080808080ULL) == 0) {
+                size_t n = std::min<size_t>(8, count - i);
+                for (size_t k = 0; k < n; ++k) {
+                    values[i + k] = in[k];
+                }
+                i += n;
+                in += n;
+                continue;
+            }
+            uint64_t stops = ~word & 0x8080808080808080ULL;
+            if (stops == 0) {
+                // The only varint with no stop in 8 bytes: 9 bytes long, the last one whole
+                values[i++] = packVarintGroups(word, 8) | uint64_t(in[8]) << 56;
+                in += 9;
+                continue;
+            }
+            int used = 0;
+            while (stops != 0 && i < count) {
+                int next = countTrailingZeros64(stops) / 8 + 1;
+                values[i++] = packVarintGroups(word >> (used * 8), next - used);
+                used = next;
+                stops &= stops - 1;
+            }
+            in += used;
+        }
+        for (; i < count; ++i) {
+            in = readVarUint64(in, end, values[i]);
+        }
+        return in - start;
+    }
+
+    // Masked VByte (Plaisance, Kurz, Lemire): the continuation bits of the next 8 bytes index
+    // a table giving how many whole varints start there and a shuffle that moves each one
+    // into its own 16-bit lane (all of them 1-2 bytes) or 32-bit lane (all of them 1-4 bytes)
+    struct VarintShuffle {
+        uint8_t count;
+        uint8_t consumed;
+        int8_t shuffle[16];
+    };
+
+    struct VarintTables {
+        VarintShuffle lanes16[256];
+        VarintShuffle lanes32[256];
+    };
+
+    inline void buildVarintShuffle(int mask, int lane_bytes, int max_values, VarintShuffle &entry) {
+        std::fill(entry.shuffle, entry.shuffle + 16, -1);
+        int pos = 0;
+        int count = 0;
+        while (count < max_values && pos < 8) {
+            int len = 1;
+            while (pos + len - 1 < 8 && ((mask >> (pos + len - 1)) & 1)) {
+                ++len;
+            }
+            if (pos + len > 8 || len > lane_bytes) {
+                break; // Runs past the 8 bytes or does not fit the lane
+            }
+            for (int b = 0; b < len; ++b) {
+                entry.shuffle[count * lane_bytes + b] = static_cast<int8_t>(pos + b);
+            }
+            pos += len;
+            ++count;
+        }
+        entry.count = static_cast<uint8_t>(count);
+        entry.consumed = static_cast<uint8_t>(pos);
+    }
+
+    inline const VarintTables &varintTables() {
+        static const VarintTables *tables = [] {
+            VarintTables *built = new VarintTables;
+            for (int mask = 0; mask < 256; ++mask) {
+                buildVarintShuffle(mask, 2, 8, built->lanes16[mask]);
+                buildVarintShuffle(mask, 4, 4, built->lanes32[mask]);
+            }
+            return built;
+        }();
+        return *tables;
+    }
+
+#if defined(__x86_64__) || defined(_M_X64)
+    // Drop the continuation bits of 16-bit lanes holding two varint bytes
+    FURY_TARGET_AVX2 inline __m128i joinVarintLanes16(__m128i lanes) {
+        return _mm_or_si128(_mm_and_si128(lanes, _mm_set1_epi16(0x007F)),
+                            _mm_srli_epi16(_mm_and_si128(lanes, _mm_set1_epi16(0x7F00)), 1));
+    }
+
+    FURY_TARGET_AVX2 inline __m128i joinVarintLanes32(__m128i lanes) {
+        __m128i joined = _mm_and_si128(lanes, _mm_set1_epi32(0x7F));
+        joined = _mm_or_si128(joined, _mm_and_si128(_mm_srli_epi32(lanes, 1), _mm_set1_epi32(0x3F80)));
+        joined = _mm_or_si128(joined, _mm_and_si128(_mm_srli_epi32(lanes, 2), _mm_set1_epi32(0x1FC000)));
+        return _mm_or_si128(joined, _mm_and_si128(_mm_srli_epi32(lanes, 3), _mm_set1_epi32(0xFE00000)));
+    }
+
+    // Decode one step from 16 readable bytes into room for 16 values. Returns the number of
+    // values written, or 0 when the next varint is too long for the vector path.
+    template <typename T>
+    FURY_TARGET_AVX2 inline size_t decodeVarintStep_AVX2(const uint8_t *&in, T *values);
+
+    template <>
+    FURY_TARGET_AVX2 inline size_t decodeVarintStep_AVX2<uint32_t>(const uint8_t *&in, uint32_t *values) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in));
+        uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(bytes));
+        if (mask == 0) {
+            // Sixteen single-byte varints
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(values), _mm256_cvtepu8_epi32(bytes));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(values + 8), _mm256_cvtepu8_epi32(_mm_srli_si128(bytes, 8)));
+            in += 16;
+            return 16;
+        }
+
+        const VarintShuffle &narrow = varintTables().lanes16[mask & 0xFF];
+        const VarintShuffle &wide = varintTables().lanes32[mask & 0xFF];
+        if (narrow.count > 0 && narrow.count >= wide.count) {
+            __m128i lanes = _mm_shuffle_epi8(bytes, _mm_loadu_si128(reinterpret_cast<const __m128i *>(narrow.shuffle)));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(values), _mm256_cvtepu16_epi32(joinVarintLanes16(lanes)));
+            in += narrow.consumed;
+            return narrow.count;
+        }
+        if (wide.count > 0) {
+            __m128i lanes = _mm_shuffle_epi8(bytes, _mm_loadu_si128(reinterpret_cast<const __m128i *>(wide.shuffle)));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(values), joinVarintLanes32(lanes));
+            in += wide.consumed;
+            return wide.count;
+        }
+        return 0;
+    }
+
+    template <>
+    FURY_TARGET_AVX2 inline size_t decodeVarintStep_AVX2<uint64_t>(const uint8_t *&in, uint64_t *values) {
+        __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in));
+        uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(bytes));
+        if ((mask & 0xFF) == 0) {
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(values), _mm256_cvtepu8_epi64(bytes));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(values + 4), _mm256_cvtepu8_epi64(_mm_srli_si128(bytes, 4)));
+            in += 8;
+            return 8;
+        }
+
+        const VarintShuffle &narrow = varintTables().lanes16[mask & 0xFF];
+        const VarintShuffle &wide = varintTables().lanes32[mask & 0xFF];
+        if (narrow.count > 0 && narrow.count >= wide.count) {
+            __m128i lanes = joinVarintLanes16(_mm_shuffle_epi8(bytes, _mm_loadu_si128(reinterpret_cast<const __m128i *>(narrow.shuffle))));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(values), _mm256_cvtepu16_epi64(lanes));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(values + 4), _mm256_cvtepu16_epi64(_mm_srli_si128(lanes, 8)));
+            in += narrow.consumed;
+            return narrow.count;
+        }
+        if (wide.count > 0) {
+            __m128i lanes = _mm_shuffle_epi8(bytes, _mm_loadu_si128(reinterpret_cast<const __m128i *>(wide.shuffle)));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(values), _mm256_cvtepu32_epi64(joinVarintLanes32(lanes)));
+            in += wide.consumed;
+            return wide.count;
+        }
+        return 0;
+    }
+
+    FURY_TARGET_AVX2 inline size_t decodeVarUint32Batch_AVX2(const uint8_t *in, size_t len, uint32_t *values, size_t count) {
+        const uint8_t *start = in;
+        const uint8_t *end = in + len;
+        size_t i = 0;
+        while (i + 16 <= count && end - in >= 16) {
+            size_t decoded = decodeVarintStep_AVX2(in, values + i);
+            if (decoded == 0) {
+                in = readVarUint32(in, end, values[i]);
+                decoded = 1;
+            }
+            i += decoded;
+        }
+        for (; i < count; ++i) {
+            in = readVarUint32(in, end, values[i]);
+        }
+        return in - start;
+    }
+
+    FURY_TARGET_AVX2 inline size_t decodeVarUint64Batch_AVX2(const uint8_t *in, size_t len, uint64_t *values, size_t count) {
+        const uint8_t *start = in;
+        const uint8_t *end = in + len;
+        size_t i = 0;
+        while (i + 16 <= count && end - in >= 16) {
+            size_t decoded = decodeVarintStep_AVX2(in, values + i);
+            if (decoded == 0) {
+                in = readVarUint64(in, end, values[i]);
+                decoded = 1;
+            }
+            i += decoded;
+        }
+        for (; i < count; ++i) {
+            in = readVarUint64(in, end, values[i]);
+        }
+        return in - start;
+    }
+#else
+    inline size_t decodeVarUint32Batch_AVX2(const uint8_t *in, size_t len, uint32_t *values, size_t count) {
+        return decodeVarUint32Batch_Baseline(in, len, values, count);
+    }
+
+    inline size_t decodeVarUint64Batch_AVX2(const uint8_t *in, size_t len, uint64_t *values, size_t count) {
+        return decodeVarUint64Batch_Baseline(in, len, values, count);
+    }
+#endif
+
+    inline size_t decodeVarUint32Batch(const uint8_t *in, size_t len, uint32_t *values, size_t count) {
+#if defined(__x86_64__) || defined(_M_X64)
+        static const auto impl = cpuSupportsAVX2() ? decodeVarUint32Batch_AVX2 : decodeVarUint32Batch_Baseline;
+#else
+        static const auto impl = decodeVarUint32Batch_Baseline;
+#endif
+        return impl(in, len, values, count);
+    }
+
+    inline size_t decodeVarUint64Batch(const uint8_t *in, size_t len, uint64_t *values, size_t count) {
+#if defined(__x86_64__) || defined(_M_X64)
+        static const auto impl = cpuSupportsAVX2() ? decodeVarUint64Batch_AVX2 : decodeVarUint64Batch_Baseline;
+#else
+        static const auto impl = decodeVarUint64Batch_Baseline;
+#endif
+        return impl(in, len, values, count);
+    }
+
+    inline size_t decodeVarInt32Batch(const uint8_t *in, size_t len, int32_t *values, size_t count) {
+        uint32_t *raw = reinterpret_cast<uint32_t *>(values);
+        size_t consumed = decodeVarUint32Batch(in, len, raw, count);
+        for (size_t i = 0; i < count; ++i) {
+            values[i] = decodeZigZag32(raw[i]);
+        }
+        return consumed;
+    }
+
+    inline size_t decodeVarInt64Batch(const uint8_t *in, size_t len, int64_t *values, size_t count) {
+        uint64_t *raw = reinterpret_cast<uint64_t *>(values);
+        size_t consumed = decodeVarUint64Batch(in, len, raw, count);
+        for (size_t i = 0; i < count; ++i) {
+            values[i] = decodeZigZag64(raw[i]);
+        }
+        return consumed;
+    }
+
+    // Bulk byte swap for arrays read from or written for a peer of the other byte order. The
+    // kernels take raw memory so float and double arrays go through the same code; src and
+    // dst are either the same pointer (swap in place) or do not overlap.
+    template <typename T, T (*swap)(T)>
+    inline void byteSwapScalar(const uint8_t *src, uint8_t *dst, size_t count) {
+        for (size_t i = 0; i < count; ++i) {
+            T value;
+            std::memcpy(&value, src + i * sizeof(T), sizeof(T));
+            value = swap(value);
+            std::memcpy(dst + i * sizeof(T), &value, sizeof(T));
+        }
+    }
+
+    inline void byteSwap16_Baseline(const void *src, void *dst, size_t count) {
+        byteSwapScalar<uint16_t, byteSwap16>(static_cast<const uint8_t *>(src), static_cast<uint8_t *>(dst), count);
+    }
+
+    inline void byteSwap32_Baseline(const void *src, void *dst, size_t count) {
+        byteSwapScalar<uint32_t, byteSwap32>(static_cast<const uint8_t *>(src), static_cast<uint8_t *>(dst), count);
+    }
+
+    inline void byteSwap64_Baseline(const void *src, void *dst, size_t count) {
+        byteSwapScalar<uint64_t, byteSwap64>(static_cast<const uint8_t *>(src), static_cast<uint8_t *>(dst), count);
+    }
+
+#if defined(__x86_64__) || defined(_M_X64)
+    // Reverse the bytes of every element with one vpshufb per 32 bytes; the shuffle is the
+    // same in both 128-bit lanes, which is all vpshufb needs since no element crosses a lane
+    template <typename T, T (*swap)(T)>
+    FURY_TARGET_AVX2 inline void byteSwapVector_AVX2(const uint8_t *src, uint8_t *dst, size_t count) {
+        int8_t order[32];
+        for (int i = 0; i < 32; ++i) {
+            order[i] = static_cast<int8_t>((i & ~(sizeof(T) - 1)) + sizeof(T) - 1 - (i & (sizeof(T) - 1)));
+        }
+        const __m256i shuffle = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(order));
+
+        size_t bytes = count * sizeof(T);
+        size_t i = 0;
+        for (; i + 128 <= bytes; i += 128) {
+            __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+            __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i + 32));
+            __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i + 64));
+            __m256i d = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i + 96));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), _mm256_shuffle_epi8(a, shuffle));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i + 32), _mm256_shuffle_epi8(b, shuffle));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i + 64), _mm256_shuffle_epi8(c, shuffle));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i + 96), _mm256_shuffle_epi8(d, shuffle));
+        }
+        for (; i + 32 <= bytes; i += 32) {
+            __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), _mm256_shuffle_epi8(chunk, shuffle));
+        }
+        byteSwapScalar<T, swap>(src + i, dst + i, (bytes - i) / sizeof(T));
+    }
+
+    FURY_TARGET_AVX2 inline void byteSwap16_AVX2(const void *src, void *dst, size_t count) {
+        byteSwapVector_AVX2<uint16_t, byteSwap16>(static_cast<const uint8_t *>(src), static_cast<uint8_t *>(dst), count);
+    }
+
+    FURY_TARGET_AVX2 inline void byteSwap32_AVX2(const void *src, void *dst, size_t count) {
+        byteSwapVector_AVX2<uint32_t, byteSwap32>(static_cast<const uint8_t *>(src), static_cast<uint8_t *>(dst), count);
+    }
+
+    FURY_TARGET_AVX2 inline void byteSwap64_AVX2(const void *src, void *dst, size_t count) {
+        byteSwapVector_AVX2<uint64_t, byteSwap64>(static_cast<const uint8_t *>(src), static_cast<uint8_t *>(dst), count);
+    }
+#else
+    inline void byteSwap16_AVX2(const void *src, void *dst, size_t count) {
+        byteSwap16_Baseline(src, dst, count);
+    }
+
+    inline void byteSwap32_AVX2(const void *src, void *dst, size_t count) {
+        byteSwap32_Baseline(src, dst, count);
+    }
+
+    inline void byteSwap64_AVX2(const void *src, void *dst, size_t count) {
+        byteSwap64_Baseline(src, dst, count);
+    }
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    inline void byteSwap16_NEON(const void *src, void *dst, size_t count) {
+        const uint8_t *in = static_cast<const uint8_t *>(src);
+        uint8_t *out = static_cast<uint8_t *>(dst);
+        size_t bytes = count * 2;
+        size_t i = 0;
+        for (; i + 16 <= bytes; i += 16) {
+            vst1q_u8(out + i, vrev16q_u8(vld1q_u8(in + i)));
+        }
+        byteSwapScalar<uint16_t, byteSwap16>(in + i, out + i, (bytes - i) / 2);
+    }
+
+    inline void byteSwap32_NEON(const void *src, void *dst, size_t count) {
+        const uint8_t *in = static_cast<const uint8_t *>(src);
+        uint8_t *out = static_cast<uint8_t *>(dst);
+        size_t bytes = count * 4;
+        size_t i = 0;
+        for (; i + 16 <= bytes; i += 16) {
+            vst1q_u8(out + i, vrev32q_u8(vld1q_u8(in + i)));
+        }
+        byteSwapScalar<uint32_t, byteSwap32>(in + i, out + i, (bytes - i) / 4);
+    }
+
+    inline void byteSwap64_NEON(const void *src, void *dst, size_t count) {
+        const uint8_t *in = static_cast<const uint8_t *>(src);
+        uint8_t *out = static_cast<uint8_t *>(dst);
+        size_t bytes = count * 8;
+        size_t i = 0;
+        for (; i + 16 <= bytes; i += 16) {
+            vst1q_u8(out + i, vrev64q_u8(vld1q_u8(in + i)));
+        }
+        byteSwapScalar<uint64_t, byteSwap64>(in + i, out + i, (bytes - i) / 8);
+    }
+#else
+    inline void byteSwap16_NEON(const void *src, void *dst, size_t count) {
+        byteSwap16_Baseline(src, dst, count);
+    }
+
+    inline void byteSwap32_NEON(const void *src, void *dst, size_t count) {
+        byteSwap32_Baseline(src, dst, count);
+    }
+
+    inline void byteSwap64_NEON(const void *src, void *dst, size_t count) {
+        byteSwap64_Baseline(src, dst, count);
+    }
+#endif
+
+    inline void byteSwapArray16(const void *src, void *dst, size_t count) {
+#if defined(__x86_64__) || defined(_M_X64)
+        static const auto impl = cpuSupportsAVX2() ? byteSwap16_AVX2 : byteSwap16_Baseline;
+#else
+        static const auto impl = byteSwap16_NEON;
+#endif
+        impl(src, dst, count);
+    }
+
+    inline void byteSwapArray32(const void *src, void *dst, size_t count) {
+#if defined(__x86_64__) || defined(_M_X64)
+        static const auto impl = cpuSupportsAVX2() ? byteSwap32_AVX2 : byteSwap32_Baseline;
+#else
+        static const auto impl = byteSwap32_NEON;
+#endif
+        impl(src, dst, count);
+    }
+
+    inline void byteSwapArray64(const void *src, void *dst, size_t count) {
+#if defined(__x86_64__) || defined(_M_X64)
+        static const auto impl = cpuSupportsAVX2() ? byteSwap64_AVX2 : byteSwap64_Baseline;
+#else
+        static const auto impl = byteSwap64_NEON;
+#endif
+        impl(src, dst, count);
+    }
+
+    // Typed entry points for int16/int32/int64 (signed or not), char16_t, float and double
+    template <typename T>
+    inline void byteSwapArray(const T *src, T *dst, size_t count) {
+        static_assert(std::is_arithmetic<T>::value && (sizeof(T) == 2 || sizeof(T) == 4 || sizeof(T) == 8),
+                      "byteSwapArray needs a 2, 4 or 8 byte primitive");
+        if (sizeof(T) == 2) {
+            byteSwapArray16(src, dst, count);
+        } else if (sizeof(T) == 4) {
+            byteSwapArray32(src, dst, count);
+        } else {
+            byteSwapArray64(src, dst, count);
+        }
+    }
+
+    template <typename T>
+    inline void byteSwapArray(T *data, size_t count) {
+        byteSwapArray(data, data, count);
+    }
+
+    // Growable serialization buffer. Reserve once with ensureCapacity, then append with the
+    // write* methods, which do not check bounds. Kernels may also write straight to
+    // data() + writerIndex() and then advanceWriterIndex.
+    class Buffer {
+    public:
+        // Bytes allocated past capacity(), so stores wider than the value they write stay inside
+        // the allocation: a varint's 8-byte store runs at most 7 bytes past a 1-byte varint
+        // (a 9-byte varuint64 ends on a single-byte store), and a 16-byte vector store at most
+        // 15 past the last byte of its value
+        static const size_t kSlack = 16;
+
+        Buffer() {}
+
+        explicit Buffer(size_t capacity) {
+            reserve(capacity);
+        }
+
+        Buffer(Buffer &&other) = default;
+        Buffer &operator=(Buffer &&other) = default;
+
+        uint8_t *data() {
+            return data_.get();
+        }
+
+        const uint8_t *data() const {
+            return data_.get();
+        }
+
+        size_t capacity() const {
+            return capacity_;
+        }
+
+        size_t writerIndex() const {
+            return writer_index_;
+        }
+
+        void setWriterIndex(size_t index) {
+            writer_index_ = index;
+        }
+
+        void advanceWriterIndex(size_t count) {
+            writer_index_ += count;
+        }
+
+        size_t readerIndex() const {
+            return reader_index_;
+        }
+
+        void setReaderIndex(size_t index) {
+            if (index > writer_index_) {
+                throw std::runtime_error("Reader index past the writer index");
+            }
+            reader_index_ = index;
+        }
+
+        void clear() {
+            writer_index_ = 0;
+            reader_index_ = 0;
+        }
+
+        void reserve(size_t capacity) {
+            if (capacity > capacity_) {
+                reallocate(capacity);
+            }
+        }
+
+        // Make room for extra more bytes at the writer index
+        inline void ensureCapacity(size_t extra) {
+            if (extra > capacity_ - writer_index_) {
+                reallocate(std::max(writer_index_ + extra, std::max<size_t>(capacity_ * 2, 64)));
+            }
+        }
+
+        // Unchecked access at an absolute offset
+        template <typename T>
+        inline void put(size_t offset, T value) {
+            std::memcpy(data_.get() + offset, &value, sizeof(T));
+        }
+
+        template <typename T>
+        inline T get(size_t offset) const {
+            T value;
+            std::memcpy(&value, data_.get() + offset, sizeof(T));
+            return value;
+        }
+
+        // Unchecked appends at the writer index
+        template <typename T>
+        inline void write(T value) {
+            put(writer_index_, value);
+            writer_index_ += sizeof(T);
+        }
+
+        inline void writeInt8(int8_t value) {
+            write(value);
+        }
+
+        inline void writeInt16(int16_t value) {
+            write(value);
+        }
+
+        inline void writeInt32(int32_t value) {
+            write(value);
+        }
+
+        inline void writeInt64(int64_t value) {
+            write(value);
+        }
+
+        inline void writeFloat32(float value) {
+            write(value);
+        }
+
+        inline void writeFloat64(double value) {
+            write(value);
+        }
+
+        inline void writeBytes(const void *bytes, size_t length) {
+            std::memcpy(data_.get() + writer_index_, bytes, length);
+            writer_index_ += length;
+        }
+
+        // At most 5 bytes
+        inline void writeVarUint32(uint32_t value) {
+            writer_index_ = fury::writeVarUint32(value, data_.get() + writer_index_) - data_.get();
+        }
+
+        inline void writeVarInt32(int32_t value) {
+            writeVarUint32(encodeZigZag32(value));
+        }
+
+        // At most 9 bytes: the 9th, for values from 2^56 up, is a plain byte after the 8-byte store
+        inline void writeVarUint64(uint64_t value) {
+            writer_index_ = fury::writeVarUint64(value, data_.get() + writer_index_) - data_.get();
+        }
+
+        inline void writeVarInt64(int64_t value) {
+            writeVarUint64(encodeZigZag64(value));
+        }
+
+        // Reads at the reader index are checked against the writer index, which setWriterIndex
+        // may have moved below the reader index
+        template <typename T>
+        inline T read() {
+            if (reader_index_ > writer_index_ || sizeof(T) > writer_index_ - reader_index_) {
+                throw std::runtime_error("Read past the end of the buffer");
+            }
+            T value = get<T>(reader_index_);
+            reader_index_ += sizeof(T);
+            return value;
+        }
+
+        inline uint32_t readVarUint32() {
+            uint32_t value;
+            reader_index_ = fury::readVarUint32(data_.get() + reader_index_, readEnd(), value) - data_.get();
+            return value;
+        }
+
+        inline int32_t readVarInt32() {
+            return decodeZigZag32(readVarUint32());
+        }
+
+        inline uint64_t readVarUint64() {
+            uint64_t value;
+            reader_index_ = fury::readVarUint64(data_.get() + reader_index_, readEnd(), value) - data_.get();
+            return value;
+        }
+
+        inline int64_t readVarInt64() {
+            return decodeZigZag64(readVarUint64());
+        }
+
+    private:
+        // End of the readable bytes, for readers that stop at in == end
+        const uint8_t *readEnd() const {
+            if (reader_index_ > writer_index_) {
+                throw std::runtime_error("Read past the end of the buffer");
+            }
+            return data_.get() + writer_index_;
+        }
+
+        void reallocate(size_t capacity) {
+            // new[] without () leaves the bytes uninitialized, unlike std::vector::resize
+            std::unique_ptr<uint8_t[]> data(new uint8_t[capacity + kSlack]);
+            if (writer_index_ > 0) {
+                std::memcpy(data.get(), data_.get(), writer_index_);
+            }
+            data_ = std::move(data);
+            capacity_ = capacity;
+        }
+
+        std::unique_ptr<uint8_t[]> data_;
+        size_t capacity_ = 0;
+        size_t writer_index_ = 0;
+        size_t reader_index_ = 0;
+    };
+
+    // Keeps released buffers so the next message reuses their storage instead of growing a
+    // fresh one. Not thread-safe; threadBufferPool gives each thread its own.
+    class BufferPool {
+    public:
+        explicit BufferPool(size_t max_pooled = 16, size_t initial_capacity = 4096)
+                : max_pooled_(max_pooled), initial_capacity_(initial_capacity) {}
+
+        Buffer acquire() {
+            if (free_.empty()) {
+                return Buffer(initial_capacity_);
+            }
+            Buffer buffer = std::move(free_.back());
+            free_.pop_back();
+            return buffer;
+        }
+
+        void release(Buffer &&buffer) {
+            if (free_.size() < max_pooled_) {
+                buffer.clear();
+                free_.push_back(std::move(buffer));
+            }
+        }
+
+    private:
+        size_t max_pooled_;
+        size_t initial_capacity_;
+        std::vector<Buffer> free_;
+    };
+
+    inline BufferPool &threadBufferPool() {
+        static thread_local BufferPool pool;
+        return pool;
+    }
+
+    // Fury string serialization: a varuint64 header (byte length << 2 | coder) followed by the
+    // payload in the smallest of three coders. UTF-16 payloads are little-endian.
+    enum class StringCoder : uint8_t {
+        LATIN1 = 0,
+        UTF16 = 1,
+        UTF8 = 2,
+    };
+
+    // Everything the coder choice needs, gathered in one pass over the UTF-16 units
+    struct Utf16Stats {
+        bool latin1;        // every unit is at most 0xFF
+        size_t utf8_length; // exact for well-formed input, an upper bound otherwise
+    };
+
+    inline Utf16Stats computeUtf16Stats_Baseline(const char16_t *data, size_t len) {
+        size_t above_latin1 = 0;
+        size_t utf8_length = len;
+        for (size_t i = 0; i < len; ++i) {
+            char16_t c = data[i];
+            above_latin1 += c > 0xFF;
+            utf8_length += c >= 0x80;
+            utf8_length += c >= 0x800 && (c & 0xF800) != 0xD800; // A surrogate pair is 2 + 2
+        }
+        return {above_latin1 == 0, utf8_length};
+    }
+
+    inline bool isLatin1_Baseline(const char16_t *data, size_t len) {
+        for (size_t i = 0; i < len; ++i) {
+            if (data[i] > 0xFF) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // Two vectors per iteration, or-ed together before the single test
+    template <typename Arch>
+    FURY_ALWAYS_INLINE bool isLatin1Kernel(const char16_t *data, size_t len) {
+        typedef simd::Vec<Arch, uint16_t> V;
+        const uint16_t *units = reinterpret_cast<const uint16_t *>(data);
+        const V high_byte = V::splat(0xFF00);
+        size_t i = 0;
+        for (; i + 2 * V::lanes <= len; i += 2 * V::lanes) {
+            V merged = V::load(units + i) | V::load(units + i + V::lanes);
+            if (!testz(merged, high_byte)) {
+                return false;
+            }
+        }
+        return isLatin1_Baseline(data + i, len - i);
+    }
+
+    inline size_t compressLatin1_Baseline(const char16_t *data, size_t len, uint8_t *out) {
+        for (size_t i = 0; i < len; ++i) {
+            out[i] = static_cast<uint8_t>(data[i]);
+        }
+        return len;
+    }
+
+    inline size_t inflateLatin1_Baseline(const uint8_t *data, size_t len, char16_t *out) {
+        for (size_t i = 0; i < len; ++i) {
+            out[i] = data[i];
+        }
+        return len;
+    }
+
+    // Encode the code point starting at data[i] and return the index after it. A lone
+    // surrogate becomes '?', as Java's String.getBytes does.
+    inline size_t encodeUtf8Char(const char16_t *data, size_t len, size_t i, uint8_t *&out) {
+        uint32_t c = data[i++];
+        if (c < 0x80) {
+            *out++ = static_cast<uint8_t>(c);
+        } else if (c < 0x800) {
+            *out++ = static_cast<uint8_t>(0xC0 | (c >> 6));
+            *out++ = static_cast<uint8_t>(0x80 | (c & 0x3F));
+        } else if ((c & 0xF800) != 0xD800) {
+            *out++ = static_cast<uint8_t>(0xE0 | (c >> 12));
+            *out++ = static_cast<uint8_t>(0x80 | ((c >> 6) & 0x3F));
+            *out++ = static_cast<uint8_t>(0x80 | (c & 0x3F));
+        } else if (c < 0xDC00 && i < len && (data[i] & 0xFC00) == 0xDC00) {
+            c = 0x10000 + ((c - 0xD800) << 10) + (data[i++] - 0xDC00);
+            *out++ = static_cast<uint8_t>(0xF0 | (c >> 18));
+            *out++ = static_cast<uint8_t>(0x80 | ((c >> 12) & 0x3F));
+            *out++ = static_cast<uint8_t>(0x80 | ((c >> 6) & 0x3F));
+            *out++ = static_cast<uint8_t>(0x80 | (c & 0x3F));
+        } else {
+            *out++ = '?';
+        }
+        return i;
+    }
+
+    // Decode the UTF-8 sequence starting at data[i] and return the index after it
+    inline size_t decodeUtf8Char(const uint8_t *data, size_t len, size_t i, char16_t *&out) {
+        uint32_t lead = data[i++];
+        if (lead < 0x80) {
+            *out++ = static_cast<char16_t>(lead);
+            return i;
+        }
+        size_t extra = lead >= 0xF0 ? 3 : lead >= 0xE0 ? 2 : lead >= 0xC0 ? 1 : 0;
+        if (extra == 0 || lead > 0xF4 || len - i < extra) {
+            throw std::runtime_error("Invalid UTF-8 sequence");
+        }
+        uint32_t c = lead & (0x3F >> extra);
+        for (size_t k = 0; k < extra; ++k) {
+            uint8_t byte = data[i++];
+            if ((byte & 0xC0) != 0x80) {
+                throw std::runtime_error("Invalid UTF-8 sequence");
+            }
+            c = (c << 6) | (byte & 0x3F);
+        }
+        static const uint32_t min_code_point[4] = {0, 0x80, 0x800, 0x10000};
+        if (c < min_code_point[extra] || c > 0x10FFFF || (c >= 0xD800 && c <= 0xDFFF)) {
+            throw std::runtime_error("Invalid UTF-8 sequence");
+        }
+        if (c >= 0x10000) {
+            c -= 0x10000;
+            *out++ = static_cast<char16_t>(0xD800 + (c >> 10));
+            *out++ = static_cast<char16_t>(0xDC00 + (c & 0x3FF));
+        } else {
+            *out++ = static_cast<char16_t>(c);
+        }
+        return i;
+    }
+
+    inline size_t utf16ToUtf8_Baseline(const char16_t *data, size_t len, uint8_t *out) {
+        uint8_t *start = out;
+        for (size_t i = 0; i < len;) {
+            i = encodeUtf8Char(data, len, i, out);
+        }
+        return out - start;
+    }
+
+    inline size_t utf8ToUtf16_Baseline(const uint8_t *data, size_t len, char16_t *out) {
+        char16_t *start = out;
+        for (size_t i = 0; i < len;) {
+            i = decodeUtf8Char(data, len, i, out);
+        }
+        return out - start;
+    }
+
+#if defined(__x86_64__) || defined(_M_X64)
+    // Unsigned c >= bound for every 16-bit lane
+    FURY_TARGET_AVX2 inline __m256i atLeast16_AVX2(__m256i chars, uint16_t bound) {
+        return _mm256_cmpeq_epi16(_mm256_max_epu16(chars, _mm256_set1_epi16(static_cast<short>(bound))), chars);
+    }
+
+    FURY_TARGET_AVX2 inline Utf16Stats computeUtf16Stats_AVX2(const char16_t *data, size_t len) {
+        const __m256i surrogate_mask = _mm256_set1_epi16(static_cast<short>(0xF800));
+        const __m256i surrogate = _mm256_set1_epi16(static_cast<short>(0xD800));
+        __m256i above_latin1 = _mm256_setzero_si256();
+        size_t extra_bytes = 0;
+        size_t i = 0;
+        for (; i + 16 <= len; i += 16) {
+            __m256i chars = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+            __m256i is_surrogate = _mm256_cmpeq_epi16(_mm256_and_si256(chars, surrogate_mask), surrogate);
+            __m256i two_or_more = atLeast16_AVX2(chars, 0x80);
+            __m256i three = _mm256_andnot_si256(is_surrogate, atLeast16_AVX2(chars, 0x800));
+            above_latin1 = _mm256_or_si256(above_latin1, atLeast16_AVX2(chars, 0x100));
+            // Each lane sets two movemask bits
+            extra_bytes += (popCount(static_cast<uint32_t>(_mm256_movemask_epi8(two_or_more))) +
+                            popCount(static_cast<uint32_t>(_mm256_movemask_epi8(three)))) / 2;
+        }
+        Utf16Stats tail = computeUtf16Stats_Baseline(data + i, len - i);
+        return {tail.latin1 && _mm256_testz_si256(above_latin1, above_latin1), i + extra_bytes + tail.utf8_length};
+    }
+
+    FURY_TARGET_AVX2 inline bool isLatin1_AVX2(const char16_t *data, size_t len) {
+        return isLatin1Kernel<simd::AVX2>(data, len);
+    }
+
+    FURY_TARGET_AVX2 inline size_t compressLatin1_AVX2(const char16_t *data, size_t len, uint8_t *out) {
+        size_t i = 0;
+        for (; i + 32 <= len; i += 32) {
+            __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+            __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i + 16));
+            // packus interleaves the 128-bit lanes of a and b; put them back in order
+            __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8);
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), packed);
+        }
+        compressLatin1_Baseline(data + i, len - i, out + i);
+        return len;
+    }
+
+    FURY_TARGET_AVX2 inline size_t inflateLatin1_AVX2(const uint8_t *data, size_t len, char16_t *out) {
+        size_t i = 0;
+        for (; i + 16 <= len; i += 16) {
+            __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), _mm256_cvtepu8_epi16(bytes));
+        }
+        inflateLatin1_Baseline(data + i, len - i, out + i);
+        return len;
+    }
+
+    FURY_TARGET_AVX2 inline size_t utf16ToUtf8_AVX2(const char16_t *data, size_t len, uint8_t *out) {
+        uint8_t *start = out;
+        size_t i = 0;
+        while (i + 16 <= len) {
+            __m256i chars = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+            if (_mm256_movemask_epi8(atLeast16_AVX2(chars, 0x80)) == 0) {
+                __m128i ascii = _mm_packus_epi16(_mm256_castsi256_si128(chars), _mm256_extracti128_si256(chars, 1));
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(out), ascii);
+                out += 16;
+                i += 16;
+                continue;
+            }
+            size_t block_end = i + 16;
+            while (i < block_end) {
+                i = encodeUtf8Char(data, len, i, out);
+            }
+        }
+        while (i < len) {
+            i = encodeUtf8Char(data, len, i, out);
+        }
+        return out - start;
+    }
+
+    FURY_TARGET_AVX2 inline size_t utf8ToUtf16_AVX2(const uint8_t *data, size_t len, char16_t *out) {
+        char16_t *start = out;
+        size_t i = 0;
+        while (i + 16 <= len) {
+            __m128i bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
+            if (_mm_movemask_epi8(bytes) == 0) {
+                _mm256_storeu_si256(reinterpret_cast<__m256i *>(out), _mm256_cvtepu8_epi16(bytes));
+                out += 16;
+                i += 16;
+                continue;
+            }
+            size_t block_end = i + 16;
+            while (i < block_end) {
+                i = decodeUtf8Char(data, len, i, out);
+            }
+        }
+        while (i < len) {
+            i = decodeUtf8Char(data, len, i, out);
+        }
+        return out - start;
+    }
+#else
+    inline Utf16Stats computeUtf16Stats_AVX2(const char16_t *data, size_t len) {
+        return computeUtf16Stats_Baseline(data, len);
+    }
+
+    inline bool isLatin1_AVX2(const char16_t *data, size_t len) {
+        return isLatin1_Baseline(data, len);
+    }
+
+    inline size_t compressLatin1_AVX2(const char16_t *data, size_t len, uint8_t *out) {
+        return compressLatin1_Baseline(data, len, out);
+    }
+
+    inline size_t inflateLatin1_AVX2(const uint8_t *data, size_t len, char16_t *out) {
+        return inflateLatin1_Baseline(data, len, out);
+    }
+
+    inline size_t utf16ToUtf8_AVX2(const char16_t *data, size_t len, uint8_t *out) {
+        return utf16ToUtf8_Baseline(data, len, out);
+    }
+
+    inline size_t utf8ToUtf16_AVX2(const uint8_t *data, size_t len, char16_t *out) {
+        return utf8ToUtf16_Baseline(data, len, out);
+    }
+#endif
+
+#if defined(FURY_HAS_RVV)
+    inline bool isLatin1_RISCV(const char16_t *data, size_t len) {
+        const uint16_t *units = reinterpret_cast<const uint16_t *>(data);
+        for (size_t i = 0, vl; i < len; i += vl) {
+            vl = __riscv_vsetvl_e16m8(len - i);
+            vbool2_t above_latin1 = __riscv_vmsgtu_vx_u16m8_b2(__riscv_vle16_v_u16m8(units + i, vl), 0xFF, vl);
+            if (__riscv_vfirst_m_b2(above_latin1, vl) >= 0) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    // 16-bit units at LMUL=8 narrow to bytes at LMUL=4; both have the same vl for a given avl
+    inline size_t compressLatin1_RISCV(const char16_t *data, size_t len, uint8_t *out) {
+        const uint16_t *units = reinterpret_cast<const uint16_t *>(data);
+        for (size_t i = 0, vl; i < len; i += vl) {
+            vl = __riscv_vsetvl_e16m8(len - i);
+            vuint8m4_t bytes = __riscv_vncvt_x_x_w_u8m4(__riscv_vle16_v_u16m8(units + i, vl), vl);
+            __riscv_vse8_v_u8m4(out + i, bytes, vl);
+        }
+        return len;
+    }
+
+    inline size_t inflateLatin1_RISCV(const uint8_t *data, size_t len, char16_t *out) {
+        uint16_t *units = reinterpret_cast<uint16_t *>(out);
+        for (size_t i = 0, vl; i < len; i += vl) {
+            vl = __riscv_vsetvl_e8m4(len - i);
+            vuint16m8_t widened = __riscv_vzext_vf2_u16m8(__riscv_vle8_v_u8m4(data + i, vl), vl);
+            __riscv_vse16_v_u16m8(units + i, widened, vl);
+        }
+        return len;
+    }
+#else
+    inline bool isLatin1_RISCV(const char16_t *data, size_t len) {
+        return isLatin1_Baseline(data, len);
+    }
+
+    inline size_t compressLatin1_RISCV(const char16_t *data, size_t len, uint8_t *out) {
+        return compressLatin1_Baseline(data, len, out);
+    }
+
+    inline size_t inflateLatin1_RISCV(const uint8_t *data, size_t len, char16_t *out) {
+        return inflateLatin1_Baseline(data, len, out);
+    }
+#endif
+
+    struct StringKernels {
+        Utf16Stats (*stats)(const char16_t *, size_t);
+        bool (*isLatin1)(const char16_t *, size_t);
+        size_t (*compressLatin1)(const char16_t *, size_t, uint8_t *);
+        size_t (*inflateLatin1)(const uint8_t *, size_t, char16_t *);
+        size_t (*utf16ToUtf8)(const char16_t *, size_t, uint8_t *);
+        size_t (*utf8ToUtf16)(const uint8_t *, size_t, char16_t *);
+    };
+
+    inline const StringKernels &stringKernels() {
+        static const StringKernels baseline = {computeUtf16Stats_Baseline, isLatin1_Baseline, compressLatin1_Baseline, inflateLatin1_Baseline,
+                                               utf16ToUtf8_Baseline, utf8ToUtf16_Baseline};
+#if defined(__x86_64__) || defined(_M_X64)
+        static const StringKernels avx2 = {computeUtf16Stats_AVX2, isLatin1_AVX2, compressLatin1_AVX2, inflateLatin1_AVX2,
+                                           utf16ToUtf8_AVX2, utf8ToUtf16_AVX2};
+        static const StringKernels &impl = cpuSupportsAVX2() ? avx2 : baseline;
+        return impl;
+#elif defined(FURY_HAS_RVV)
+        // The transcoders have no RVV version yet
+        static const StringKernels rvv = {baseline.stats, isLatin1_RISCV, compressLatin1_RISCV, inflateLatin1_RISCV,
+                                          baseline.utf16ToUtf8, baseline.utf8ToUtf16};
+        return rvv;
+#else
+        return baseline;
+#endif
+    }
+
+    // Every unit is at most 0xFF, so compressLatin1 is lossless
+    inline bool isLatin1(const char16_t *data, size_t len) {
+        return stringKernels().isLatin1(data, len);
+    }
+
+    // Narrow Latin-1 units to bytes; out needs len bytes
+    inline size_t compressLatin1(const char16_t *data, size_t len, uint8_t *out) {
+        return stringKernels().compressLatin1(data, len, out);
+    }
+
+    // Widen Latin-1 bytes to UTF-16 units; out needs len units
+    inline size_t inflateLatin1(const uint8_t *data, size_t len, char16_t *out) {
+        return stringKernels().inflateLatin1(data, len, out);
+    }
+
+    // Transcode and return the bytes written; out needs 3 * len bytes
+    inline size_t utf16ToUtf8(const char16_t *data, size_t len, uint8_t *out) {
+        return stringKernels().utf16ToUtf8(data, len, out);
+    }
+
+    // Transcode and return the units written; out needs len units. Throws std::runtime_error
+    // on malformed UTF-8.
+    inline size_t utf8ToUtf16(const uint8_t *data, size_t len, char16_t *out) {
+        return stringKernels().utf8ToUtf16(data, len, out);
+    }
+
+    // Length of the well-formed UTF-8 sequence at data[i], or 0 if it is malformed: a stray
+    // continuation byte, a truncated sequence, an overlong form, a surrogate or > U+10FFFF
+    inline size_t utf8SequenceLength(const uint8_t *data, size_t len, size_t i) {
+        uint8_t lead = data[i];
+        if (lead < 0x80) {
+            return 1;
+        }
+        size_t extra = lead >= 0xF0 ? 3 : lead >= 0xE0 ? 2 : lead >= 0xC0 ? 1 : 0;
+        if (extra == 0 || lead > 0xF4 || len - i - 1 < extra) {
+            return 0;
+        }
+        uint32_t c = lead & (0x3F >> extra);
+        for (size_t k = 1; k <= extra; ++k) {
+            if ((data[i + k] & 0xC0) != 0x80) {
+                return 0;
+            }
+            c = (c << 6) | (data[i + k] & 0x3F);
+        }
+        static const uint32_t min_code_point[4] = {0, 0x80, 0x800, 0x10000};
+        if (c < min_code_point[extra] || c > 0x10FFFF || (c >= 0xD800 && c <= 0xDFFF)) {
+            return 0;
+        }
+        return extra + 1;
+    }
+
+    // Return len when data is valid UTF-8, else the offset of the first malformed sequence
+    inline size_t validateUtf8_Baseline(const uint8_t *data, size_t len) {
+        size_t i = 0;
+        while (i < len) {
+            size_t length = utf8SequenceLength(data, len, i);
+            if (length == 0) {
+                return i;
+            }
+            i += length;
+        }
+        return len;
+    }
+
+#if defined(__x86_64__) || defined(_M_X64)
+    // ASCII blocks are skipped 32 bytes at a time, the rest is checked per sequence
+    FURY_TARGET_AVX2 inline size_t validateUtf8_AVX2(const uint8_t *data, size_t len) {
+        size_t i = 0;
+        while (i + 32 <= len) {
+            __m256i bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
+            if (_mm256_movemask_epi8(bytes) == 0) {
+                i += 32;
+                continue;
+            }
+            size_t block_end = i + 32;
+            while (i < block_end) {
+                size_t length = utf8SequenceLength(data, len, i);
+                if (length == 0) {
+                    return i;
+                }
+                i += length;
+            }
+        }
+        size_t tail = validateUtf8_Baseline(data + i, len - i);
+        return i + tail;
+    }
+#else
+    inline size_t validateUtf8_AVX2(const uint8_t *data, size_t len) {
+        return validateUtf8_Baseline(data, len);
+    }
+#endif
+
+    inline size_t validateUtf8(const uint8_t *data, size_t len) {
+#if defined(__x86_64__) || defined(_M_X64)
+        static const auto impl = cpuSupportsAVX2() ? validateUtf8_AVX2 : validateUtf8_Baseline;
+#else
+        static const auto impl = validateUtf8_Baseline;
+#endif
+        return impl(data, len);
+    }
+
+    // The smallest coder wins; UTF-16 on a tie since it decodes with a plain copy
+    inline StringCoder chooseStringCoder(const Utf16Stats &stats, size_t len) {
+        if (stats.latin1) {
+            return StringCoder::LATIN1;
+        }
+        return stats.utf8_length < len * 2 ? StringCoder::UTF8 : StringCoder::UTF16;
+    }
+
+    // Write header and payload for data to out and return the number of bytes written. out
+    // needs room for the bound returned by writeStringBound.
+    inline size_t writeStringUnchecked(const char16_t *data, size_t len, StringCoder coder, size_t payload_bound,
+                                       uint8_t *out) {
+        // The header is written for the expected length; only lone surrogates in UTF-8 can
+        // make the payload shorter, and then the header is rewritten
+        uint8_t header[16];
+        size_t header_length = writeVarUint64(uint64_t(payload_bound) << 2 | static_cast<uint8_t>(coder), header) - header;
+        uint8_t *payload = out + header_length;
+
+        const StringKernels &kernels = stringKernels();
+        size_t payload_length;
+        switch (coder) {
+            case StringCoder::LATIN1:
+                payload_length = kernels.compressLatin1(data, len, payload);
+                break;
+            case StringCoder::UTF16:
+                std::memcpy(payload, data, len * 2);
+                payload_length = len * 2;
+                break;
+            default:
+                payload_length = kernels.utf16ToUtf8(data, len, payload);
+                break;
+        }
+
+        if (payload_length != payload_bound) {
+            size_t actual_header_length =
+                    writeVarUint64(uint64_t(payload_length) << 2 | static_cast<uint8_t>(coder), header) - header;
+            if (actual_header_length != header_length) {
+                std::memmove(out + actual_header_length, payload, payload_length);
+                header_length = actual_header_length;
+            }
+        }
+        std::memcpy(out, header, header_length);
+        return header_length + payload_length;
+    }
+
+    // Pick the coder for data and return the most bytes writeStringUnchecked may write
+    inline size_t writeStringBound(const char16_t *data, size_t len, StringCoder &coder, size_t &payload_bound) {
+        Utf16Stats stats = stringKernels().stats(data, len);
+        coder = chooseStringCoder(stats, len);
+        payload_bound = coder == StringCoder::LATIN1 ? len : coder == StringCoder::UTF16 ? len * 2 : stats.utf8_length;
+        return 10 + payload_bound;
+    }
+
+    // Append value to buffer and return the coder used
+    inline StringCoder writeString(const std::u16string &value, std::string &buffer) {
+        StringCoder coder;
+        size_t payload_bound;
+        size_t bound = writeStringBound(value.data(), value.size(), coder, payload_bound);
+        size_t start = buffer.size();
+        buffer.resize(start + bound);
+        size_t written = writeStringUnchecked(value.data(), value.size(), coder, payload_bound,
+                                              reinterpret_cast<uint8_t *>(&buffer[start]));
+        buffer.resize(start + written);
+        return coder;
+    }
+
+    inline StringCoder writeString(const std::u16string &value, Buffer &buffer) {
+        StringCoder coder;
+        size_t payload_bound;
+        buffer.ensureCapacity(writeStringBound(value.data(), value.size(), coder, payload_bound));
+        buffer.advanceWriterIndex(writeStringUnchecked(value.data(), value.size(), coder, payload_bound,
+                                                       buffer.data() + buffer.writerIndex()));
+        return coder;
+    }
+
+    // Read a string written by writeString at begin + reader_index and advance reader_index past it
+    inline std::u16string readString(const uint8_t *begin, const uint8_t *end, size_t &reader_index) {
+        uint64_t header;
+        const uint8_t *payload = readVarUint64(begin + reader_index, end, header);
+        uint64_t length = header >> 2;
+        if (length > static_cast<uint64_t>(end - payload)) {
+            throw std::runtime_error("Truncated string payload");
+        }
+
+        const StringKernels &kernels = stringKernels();
+        std::u16string value;
+        switch (static_cast<StringCoder>(header & 3)) {
+            case StringCoder::LATIN1:
+                value.resize(length);
+                kernels.inflateLatin1(payload, length, &value[0]);
+                break;
+            case StringCoder::UTF16:
+                if (length % 2 != 0) {
+                    throw std::runtime_error("Odd UTF-16 payload length");
+                }
+                value.resize(length / 2);
+                std::memcpy(&value[0], payload, length);
+                break;
+            case StringCoder::UTF8:
+                // Never more UTF-16 units than UTF-8 bytes, even counting the 16-unit stores
+                value.resize(length);
+                value.resize(kernels.utf8ToUtf16(payload, length, &value[0]));
+                break;
+            default:
+                throw std::runtime_error("Unknown string coder");
+        }
+        reader_index = payload + length - begin;
+        return value;
+    }
+
+    inline std::u16string readString(const std::string &buffer, size_t &reader_index) {
+        const uint8_t *begin = reinterpret_cast<const uint8_t *>(buffer.data());
+        return readString(begin, begin + buffer.size(), reader_index);
+    }
+
+    inline std::u16string readString(Buffer &buffer) {
+        size_t reader_index = buffer.readerIndex();
+        std::u16string value = readString(buffer.data(), buffer.data() + buffer.writerIndex(), reader_index);
+        buffer.setReaderIndex(reader_index);
+        return value;
+    }
+
+    inline std::string generateRandomString(size_t length) {
+        const char charset[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+        std::default_random_engine rng(std::random_device{}());
+        std::uniform_int_distribution<> dist(0, sizeof(charset) - 2);
+
+        std::string result;
+        result.reserve(length);
+        for (size_t i = 0; i < length; ++i) {
+            result += charset[dist(rng)];
+        }
+
+        return result;
+    }
+
+} // namespace fury
+
+#endif // POTIMIZER_FURY_H
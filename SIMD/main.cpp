@@ -1,157 +1,232 @@
-//#include "string_util.h"
-#include <random>
+#include "fury.h"
 #include <iostream>
-
-
-#if defined(__x86_64__) || defined(_M_X64)
-#include <immintrin.h>
-#include <emmintrin.h>
-#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
-#include <arm_neon.h>
-#elif defined(__riscv) && __riscv_vector
-#include <riscv_vector.h>
-#endif
-
-namespace fury {
-
-    bool isLatin_Baseline(const std::string &str) {
-        for (char c : str) {
-            if (static_cast<unsigned char>(c) >= 128) {
-                return false;
-            }
-        }
-        return true;
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+
+int main() {
+    // Varuint64 byte sequences as Fury writes them: 7 bits per byte up to 2^56, then a 9th
+    // byte holding the top 8 bits whole
+    const struct {
+        uint64_t value;
+        std::vector<uint8_t> bytes;
+    } fury_varints[] = {
+            {(uint64_t(1) << 56) - 1, {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x7F}},
+            {uint64_t(1) << 56, {0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x01}},
+            {0x0123456789ABCDEFULL, {0xEF, 0x9B, 0xAF, 0xCD, 0xF8, 0xAC, 0xD1, 0x91, 0x01}},
+            {uint64_t(1) << 63, {0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80}},
+            {~uint64_t(0), {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF}},
+    };
+    bool varints_match = true;
+    for (const auto &expected : fury_varints) {
+        uint8_t written[16];
+        size_t length = fury::encodeVarUint64Batch(&expected.value, 1, written);
+        uint64_t decoded = 0;
+        size_t consumed = fury::decodeVarUint64Batch(expected.bytes.data(), expected.bytes.size(), &decoded, 1);
+        varints_match = varints_match && std::vector<uint8_t>(written, written + length) == expected.bytes &&
+                        consumed == expected.bytes.size() && decoded == expected.value;
     }
-
-#if defined(__x86_64__) || defined(_M_X64)
-    bool isLatin_AVX2(const std::string &str) {
-        const char *data = str.data();
-        size_t len = str.size();
-
-        size_t i = 0;
-        __m256i latin_mask = _mm256_set1_epi8(0x80);
-        for (; i + 32 <= len; i += 32) {
-            __m256i chars = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + i));
-            __m256i result = _mm256_and_si256(chars, latin_mask);
-            if (!_mm256_testz_si256(result, result)) {
-                return false;
-            }
-        }
-
-        for (; i < len; ++i) {
-            if (static_cast<unsigned char>(data[i]) >= 128) {
-                return false;
-            }
+    // Zigzag maps INT64_MIN to all ones, and -2^55 - 1 to 2^56 + 1
+    const int64_t signed_values[] = {INT64_MIN, -(int64_t(1) << 55) - 1};
+    const std::vector<uint8_t> signed_bytes = {0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
+                                               0x81, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x80, 0x01};
+    uint8_t signed_written[32];
+    size_t signed_length = fury::encodeVarInt64Batch(signed_values, 2, signed_written);
+    int64_t signed_decoded[2] = {};
+    fury::decodeVarInt64Batch(signed_bytes.data(), signed_bytes.size(), signed_decoded, 2);
+    varints_match = varints_match &&
+                    std::vector<uint8_t>(signed_written, signed_written + signed_length) == signed_bytes &&
+                    signed_decoded[0] == signed_values[0] && signed_decoded[1] == signed_values[1];
+    std::cout << "Varint64 against Fury byte sequences" << (varints_match ? "" : " MISMATCH") << std::endl;
+
+    // Varint decoding across value-size distributions
+    const size_t count = 1 << 20;
+    const struct {
+        const char *name;
+        uint32_t max_bits;
+    } distributions[] = {{"1 byte", 7}, {"1-2 bytes", 14}, {"1-3 bytes", 21}, {"1-5 bytes", 32}};
+
+    std::mt19937 rng(42);
+    for (const auto &distribution : distributions) {
+        std::vector<uint32_t> values(count);
+        for (auto &value : values) {
+            // Uniform bit width, so small values are as common as large ones
+            uint32_t bits = 1 + rng() % distribution.max_bits;
+            value = bits == 32 ? rng() : rng() & ((1u << bits) - 1);
         }
-
-        return true;
+        std::vector<uint8_t> bytes(count * 5 + 8);
+        std::vector<uint32_t> decoded(count);
+
+        auto start_time = std::chrono::high_resolution_clock::now();
+        size_t length = fury::encodeVarUint32Batch(values.data(), count, bytes.data());
+        auto end_time = std::chrono::high_resolution_clock::now();
+        auto duration_encode = std::chrono::duration_cast<std::chrono::nanoseconds>(end_time - start_time).count();
+
+        start_time = std::chrono::high_resolution_clock::now();
+        fury::decodeVarUint32Batch_Baseline(bytes.data(), length, decoded.data(), count);
+        end_time = std::chrono::high_resolution_clock::now();
+        auto duration_baseline = std::chrono::duration_cast<std::chrono::nanoseconds>(end_time - start_time).count();
+
+        start_time = std::chrono::high_resolution_clock::now();
+        fury::decodeVarUint32Batch(bytes.data(), length, decoded.data(), count);
+        end_time = std::chrono::high_resolution_clock::now();
+        auto duration_simd = std::chrono::duration_cast<std::chrono::nanoseconds>(end_time - start_time).count();
+
+        std::cout << "Varint32 " << distribution.name << " (" << static_cast<double>(length) / count << " bytes/value)"
+                  << (decoded == values ? "" : " MISMATCH") << std::endl;
+        std::cout << "  Encode Running Time: " << duration_encode << " ns" << std::endl;
+        std::cout << "  Baseline Decode Running Time: " << duration_baseline << " ns" << std::endl;
+        std::cout << "  SIMD Decode Running Time: " << duration_simd << " ns" << std::endl;
     }
 
-    bool isLatin_SSE2(const std::string &str) {
-        const char *data = str.data();
-        size_t len = str.size();
-
-        size_t i = 0;
-        __m128i latin_mask = _mm_set1_epi8(0x80);
-        for (; i + 16 <= len; i += 16) {
-            __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + i));
-            __m128i result = _mm_and_si128(chars, latin_mask);
-            if (!_mm_testz_si128(result, result)) {
-                return false;
-            }
-        }
-
-        for (; i < len; ++i) {
-            if (static_cast<unsigned char>(data[i]) >= 128) {
-                return false;
-            }
+    // MetaString encoding of class and field names: lower case package-style names for the
+    // 5-bit encodings and camel case names with digits for the 6-bit one
+    const std::string lower_chars = "abcdefghijklmnopqrstuvwxyz._";
+    const std::string mixed_chars = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789._";
+    std::vector<std::string> names(1 << 14);
+    for (size_t i = 0; i < names.size(); ++i) {
+        const std::string &chars = i % 2 ? mixed_chars : lower_chars;
+        size_t length = 4 + rng() % 60;
+        for (size_t j = 0; j < length; ++j) {
+            names[i] += chars[rng() % chars.size()];
         }
+    }
 
-        return true;
+    bool meta_match = true;
+    size_t meta_bytes = 0;
+    for (const auto &name : names) {
+        fury::MetaString meta = fury::encodeMetaString(name);
+        meta_match = meta_match && fury::decodeMetaString(meta) == name;
+        meta_bytes += meta.bytes.size();
     }
-#else
-    bool isLatin_AVX2(const std::string &str) {
-    return isLatin_Baseline(str);
-}
 
-bool isLatin_SSE2(const std::string &str) {
-    return isLatin_Baseline(str);
-}
+#if defined(__x86_64__) || defined(_M_X64)
+    auto pack = fury::cpuSupportsAVX2() ? fury::packMetaChars_AVX2 : fury::packMetaChars_Baseline;
+#else
+    auto pack = fury::packMetaChars_Baseline;
 #endif
-
-#if defined(__ARM_NEON) || defined(__ARM_NEON__)
-    bool isLatin_NEON(const std::string &str) {
-    const char *data = str.data();
-    size_t len = str.size();
-
-    size_t i = 0;
-    uint8x16_t latin_mask = vdupq_n_u8(0x80);
-    for (; i + 16 <= len; i += 16) {
-        uint8x16_t chars = vld1q_u8(reinterpret_cast<const uint8_t *>(data + i));
-        uint8x16_t result = vandq_u8(chars, latin_mask);
-        if (vmaxvq_u8(result) != 0) {
-            return false;
+    // Each name is packed at 6 bits into room for the 16-byte vector stores; repeated so the
+    // times are not dominated by one cold pass
+    const int meta_rounds = 5;
+    std::vector<uint8_t> packed_baseline(64 * 6 / 8 + 16);
+    std::vector<uint8_t> packed_simd(packed_baseline.size());
+    size_t meta_checksum_baseline = 0;
+    size_t meta_checksum_simd = 0;
+
+    auto start_time = std::chrono::high_resolution_clock::now();
+    for (int round = 0; round < meta_rounds; ++round) {
+        for (const auto &name : names) {
+            fury::MetaStringStats stats = fury::computeMetaStringStats_Baseline(name.data(), name.size(), '.', '_');
+            fury::packMetaChars_Baseline(name.data(), name.size(), 6, '.', '_', packed_baseline.data());
+            meta_checksum_baseline += stats.upper_count + stats.digit_count + packed_baseline[0];
         }
     }
-
-    for (; i < len; ++i) {
-        if (static_cast<unsigned char>(data[i]) >= 128) {
-            return false;
+    auto end_time = std::chrono::high_resolution_clock::now();
+    auto duration_baseline = std::chrono::duration_cast<std::chrono::nanoseconds>(end_time - start_time).count();
+
+    start_time = std::chrono::high_resolution_clock::now();
+    for (int round = 0; round < meta_rounds; ++round) {
+        for (const auto &name : names) {
+            fury::MetaStringStats stats = fury::computeMetaStringStats(name, '.', '_');
+            pack(name.data(), name.size(), 6, '.', '_', packed_simd.data());
+            meta_checksum_simd += stats.upper_count + stats.digit_count + packed_simd[0];
         }
     }
-
-    return true;
-}
-#else
-    bool isLatin_NEON(const std::string &str) {
-        return isLatin_Baseline(str);
+    end_time = std::chrono::high_resolution_clock::now();
+    auto duration_simd = std::chrono::duration_cast<std::chrono::nanoseconds>(end_time - start_time).count();
+
+    meta_match = meta_match && meta_checksum_simd == meta_checksum_baseline;
+    std::cout << "MetaString of " << names.size() << " names (" << meta_bytes << " bytes encoded)"
+              << (meta_match ? "" : " MISMATCH") << std::endl;
+    std::cout << "  Baseline Stats and Pack Running Time: " << duration_baseline << " ns" << std::endl;
+    std::cout << "  SIMD Stats and Pack Running Time: " << duration_simd << " ns" << std::endl;
+
+    // Byte swap of a double array, as done for a peer of the other byte order. The arrays fit
+    // in L2, so the kernels are timed rather than DRAM; one untimed pass of each warms them
+    // and faults in swapped, then the time per pass is averaged over many
+    const size_t swap_count = 1 << 15;
+    const int swap_rounds = 1000;
+    std::vector<double> doubles(swap_count);
+    for (size_t i = 0; i < swap_count; ++i) {
+        doubles[i] = static_cast<double>(rng()) / 3;
     }
-#endif
+    std::vector<double> swapped(swap_count);
 
-#if defined(__riscv) && __riscv_vector
-    bool isLatin_RISCV(const std::string &str) {
-    const char *data = str.data();
-    size_t len = str.size();
-
-    size_t i = 0;
-    size_t vl;
-    while ((vl = vsetvl_e8m1(len - i)) > 0) {
-        vuint8m1_t chars = vle8_v_u8m1(reinterpret_cast<const uint8_t *>(data + i), vl);
-        vuint8m1_t latin_mask = vmv_v_x_u8m1(0x80, vl);
-        vbool8_t result = vmseq_vv_u8m1_b8(vand_vv_u8m1(chars, latin_mask, vl), latin_mask, vl);
-        if (vfirst_m_b8(result) != -1) {
-            return false;
-        }
-        i += vl;
-    }
+    fury::byteSwap64_Baseline(doubles.data(), swapped.data(), swap_count);
+    fury::byteSwapArray(doubles.data(), swapped.data(), swap_count);
 
-    for (; i < len; ++i) {
-        if (static_cast<unsigned char>(data[i]) >= 128) {
-            return false;
-        }
+    start_time = std::chrono::high_resolution_clock::now();
+    for (int round = 0; round < swap_rounds; ++round) {
+        fury::byteSwap64_Baseline(doubles.data(), swapped.data(), swap_count);
     }
+    end_time = std::chrono::high_resolution_clock::now();
+    duration_baseline = std::chrono::duration_cast<std::chrono::nanoseconds>(end_time - start_time).count() / swap_rounds;
 
-    return true;
-}
-#else
-    bool isLatin_RISCV(const std::string &str) {
-        return isLatin_Baseline(str);
+    start_time = std::chrono::high_resolution_clock::now();
+    for (int round = 0; round < swap_rounds; ++round) {
+        fury::byteSwapArray(doubles.data(), swapped.data(), swap_count);
     }
-#endif
+    end_time = std::chrono::high_resolution_clock::now();
+    duration_simd = std::chrono::duration_cast<std::chrono::nanoseconds>(end_time - start_time).count() / swap_rounds;
 
-    std::string generateRandomString(size_t length) {
-        const char charset[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
-        std::default_random_engine rng(std::random_device{}());
-        std::uniform_int_distribution<> dist(0, sizeof(charset) - 2);
+    std::cout << "Byte swap of " << swap_count << " doubles" << std::endl;
+    std::cout << "  Baseline Running Time: " << duration_baseline << " ns" << std::endl;
+    std::cout << "  SIMD Running Time: " << duration_simd << " ns" << std::endl;
 
-        std::string result;
-        result.reserve(length);
-        for (size_t i = 0; i < length; ++i) {
-            result += charset[dist(rng)];
-        }
-
-        return result;
+    // String serialization round trip: mostly ASCII text with some CJK, as UTF-8 on the wire
+    std::u16string text(count, u'a');
+    for (auto &c : text) {
+        c = rng() % 10 == 0 ? static_cast<char16_t>(0x4E00 + rng() % 0x5000) : static_cast<char16_t>(' ' + rng() % 95);
+    }
+    std::string buffer;
+
+    start_time = std::chrono::high_resolution_clock::now();
+    fury::StringCoder coder = fury::writeString(text, buffer);
+    end_time = std::chrono::high_resolution_clock::now();
+    auto duration_write = std::chrono::duration_cast<std::chrono::nanoseconds>(end_time - start_time).count();
+
+    size_t reader_index = 0;
+    start_time = std::chrono::high_resolution_clock::now();
+    std::u16string text_read = fury::readString(buffer, reader_index);
+    end_time = std::chrono::high_resolution_clock::now();
+    auto duration_read = std::chrono::duration_cast<std::chrono::nanoseconds>(end_time - start_time).count();
+
+    std::cout << "String of " << count << " chars as coder " << static_cast<int>(coder) << " (" << buffer.size()
+              << " bytes)" << (text_read == text ? "" : " MISMATCH") << std::endl;
+    std::cout << "  writeString Running Time: " << duration_write << " ns" << std::endl;
+    std::cout << "  readString Running Time: " << duration_read << " ns" << std::endl;
+
+    // Scans: isLatin over ASCII with one CJK character at the very end, and code point counts
+    // over text with 10% CJK
+    std::string ascii(count, 'a');
+    ascii.replace(count - 3, 3, "\xe4\xb8\xad");
+    std::string utf8;
+    for (size_t i = 0; i < count; ++i) {
+        utf8 += rng() % 10 == 0 ? "\xe4\xb8\xad" : "a";
     }
 
-} // namespace fury
-
+    start_time = std::chrono::high_resolution_clock::now();
+    bool latin_baseline = fury::isLatin_Baseline(ascii.data(), ascii.size());
+    size_t utf8_baseline = fury::count_code_points_utf8_Baseline(utf8.data(), utf8.size());
+    size_t utf16_baseline = fury::count_code_points_utf16_Baseline(text.data(), text.size());
+    end_time = std::chrono::high_resolution_clock::now();
+    duration_baseline = std::chrono::duration_cast<std::chrono::nanoseconds>(end_time - start_time).count();
+
+    start_time = std::chrono::high_resolution_clock::now();
+    bool latin = fury::isLatin(ascii);
+    size_t utf8_count = fury::count_code_points_utf8(utf8);
+    size_t utf16_count = fury::count_code_points_utf16(text);
+    end_time = std::chrono::high_resolution_clock::now();
+    duration_simd = std::chrono::duration_cast<std::chrono::nanoseconds>(end_time - start_time).count();
+
+    bool match = latin == latin_baseline && utf8_count == utf8_baseline && utf16_count == utf16_baseline;
+    std::cout << "isLatin and code point counts over " << ascii.size() + utf8.size() + text.size() * 2 << " bytes"
+              << (match ? "" : " MISMATCH") << std::endl;
+    std::cout << "  Baseline Running Time: " << duration_baseline << " ns" << std::endl;
+    std::cout << "  SIMD Running Time: " << duration_simd << " ns" << std::endl;
+
+    return 0;
+}
@@ -0,0 +1,353 @@
+// Thin portable SIMD layer for the fury kernels. A kernel is written once as a template over
+// an architecture tag and uses Vec<Arch, T> for its loads, compares and reductions; each
+// target then gets a small wrapper that instantiates it, e.g.
+//
+//     FURY_TARGET_AVX2 inline bool isLatin_AVX2(const char *data, size_t len) {
+//         return isLatinKernel<simd::AVX2>(data, len);
+//     }
+//
+// The kernel template is FURY_ALWAYS_INLINE and carries no target attribute, so it takes the
+// instruction set of the wrapper it is inlined into. Only call it from such a wrapper.
+//
+// Lanes are 8 or 16 bits wide. RVV is not covered: its vector length is only known at run
+// time, so scalable vectors cannot be stored in a Vec.
+#ifndef POTIMIZER_VEC_H
+#define POTIMIZER_VEC_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#elif defined(__riscv_v_intrinsic) && __riscv_v_intrinsic >= 11000
+// RVV 1.0 intrinsics with the __riscv_ prefix (GCC 13+, Clang 16+, built with -march=rv64gcv)
+#include <riscv_vector.h>
+#define FURY_HAS_RVV 1
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// Let the x86 kernels use their instruction set without building the whole file with it,
+// so the dispatchers can pick one at run time
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(_M_X64))
+#define FURY_TARGET_AVX2 __attribute__((target("avx2,popcnt,bmi")))
+#define FURY_TARGET_AVX512 __attribute__((target("avx512f,avx512bw,avx2,popcnt,bmi")))
+#else
+#define FURY_TARGET_AVX2
+#define FURY_TARGET_AVX512
+#endif
+
+#if defined(_MSC_VER)
+#define FURY_ALWAYS_INLINE __forceinline
+#else
+#define FURY_ALWAYS_INLINE inline __attribute__((always_inline))
+#endif
+
+namespace fury {
+namespace simd {
+
+    struct SSE2 {};
+    struct AVX2 {};
+    struct AVX512 {};
+    struct NEON {};
+
+    // load/splat/zero, store, & | ^ + - on lanes, and the free functions eq (all ones where
+    // equal), testz (no bit set in v, or in a & b), movemask (top bit of each lane, lane 0 in
+    // bit 0) and sumLanes
+    template <typename Arch, typename T>
+    struct Vec;
+
+#if defined(__x86_64__) || defined(_M_X64)
+    // SSE2 is part of x86-64, so these need no target attribute
+    template <typename T>
+    struct Vec<SSE2, T> {
+        static_assert(sizeof(T) == 1 || sizeof(T) == 2, "8- or 16-bit lanes");
+        static constexpr size_t lanes = 16 / sizeof(T);
+        __m128i raw;
+
+        static Vec load(const T *data) {
+            return {_mm_loadu_si128(reinterpret_cast<const __m128i *>(data))};
+        }
+
+        static Vec splat(T value) {
+            return {sizeof(T) == 1 ? _mm_set1_epi8(static_cast<char>(value))
+                                   : _mm_set1_epi16(static_cast<short>(value))};
+        }
+
+        static Vec zero() {
+            return {_mm_setzero_si128()};
+        }
+
+        void store(T *data) const {
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(data), raw);
+        }
+
+        friend Vec operator&(Vec a, Vec b) { return {_mm_and_si128(a.raw, b.raw)}; }
+        friend Vec operator|(Vec a, Vec b) { return {_mm_or_si128(a.raw, b.raw)}; }
+        friend Vec operator^(Vec a, Vec b) { return {_mm_xor_si128(a.raw, b.raw)}; }
+
+        friend Vec operator+(Vec a, Vec b) {
+            return {sizeof(T) == 1 ? _mm_add_epi8(a.raw, b.raw) : _mm_add_epi16(a.raw, b.raw)};
+        }
+
+        friend Vec operator-(Vec a, Vec b) {
+            return {sizeof(T) == 1 ? _mm_sub_epi8(a.raw, b.raw) : _mm_sub_epi16(a.raw, b.raw)};
+        }
+
+        friend Vec eq(Vec a, Vec b) {
+            return {sizeof(T) == 1 ? _mm_cmpeq_epi8(a.raw, b.raw) : _mm_cmpeq_epi16(a.raw, b.raw)};
+        }
+
+        // ptest is SSE4.1, so compare against zero instead
+        friend bool testz(Vec v) {
+            return _mm_movemask_epi8(_mm_cmpeq_epi8(v.raw, _mm_setzero_si128())) == 0xFFFF;
+        }
+
+        friend bool testz(Vec a, Vec b) {
+            return testz(a & b);
+        }
+
+        friend uint64_t movemask(Vec v) {
+            if (sizeof(T) == 1) {
+                return static_cast<uint32_t>(_mm_movemask_epi8(v.raw));
+            }
+            // Signed saturation keeps the top bit of each 16-bit lane
+            return static_cast<uint32_t>(_mm_movemask_epi8(_mm_packs_epi16(v.raw, _mm_setzero_si128()))) & 0xFF;
+        }
+
+        friend uint64_t sumLanes(Vec v) {
+            __m128i sums;
+            if (sizeof(T) == 1) {
+                sums = _mm_sad_epu8(v.raw, _mm_setzero_si128());
+            } else {
+                __m128i low = _mm_and_si128(v.raw, _mm_set1_epi32(0xFFFF));
+                sums = _mm_add_epi32(low, _mm_srli_epi32(v.raw, 16));
+                sums = _mm_add_epi32(sums, _mm_srli_epi64(sums, 32));
+            }
+            return static_cast<uint64_t>(_mm_cvtsi128_si32(sums)) +
+                   static_cast<uint32_t>(_mm_cvtsi128_si32(_mm_srli_si128(sums, 8)));
+        }
+    };
+
+    template <typename T>
+    struct Vec<AVX2, T> {
+        static_assert(sizeof(T) == 1 || sizeof(T) == 2, "8- or 16-bit lanes");
+        static constexpr size_t lanes = 32 / sizeof(T);
+        __m256i raw;
+
+        FURY_TARGET_AVX2 static Vec load(const T *data) {
+            return {_mm256_loadu_si256(reinterpret_cast<const __m256i *>(data))};
+        }
+
+        FURY_TARGET_AVX2 static Vec splat(T value) {
+            return {sizeof(T) == 1 ? _mm256_set1_epi8(static_cast<char>(value))
+                                   : _mm256_set1_epi16(static_cast<short>(value))};
+        }
+
+        FURY_TARGET_AVX2 static Vec zero() {
+            return {_mm256_setzero_si256()};
+        }
+
+        FURY_TARGET_AVX2 void store(T *data) const {
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(data), raw);
+        }
+
+        FURY_TARGET_AVX2 friend Vec operator&(Vec a, Vec b) { return {_mm256_and_si256(a.raw, b.raw)}; }
+        FURY_TARGET_AVX2 friend Vec operator|(Vec a, Vec b) { return {_mm256_or_si256(a.raw, b.raw)}; }
+        FURY_TARGET_AVX2 friend Vec operator^(Vec a, Vec b) { return {_mm256_xor_si256(a.raw, b.raw)}; }
+
+        FURY_TARGET_AVX2 friend Vec operator+(Vec a, Vec b) {
+            return {sizeof(T) == 1 ? _mm256_add_epi8(a.raw, b.raw) : _mm256_add_epi16(a.raw, b.raw)};
+        }
+
+        FURY_TARGET_AVX2 friend Vec operator-(Vec a, Vec b) {
+            return {sizeof(T) == 1 ? _mm256_sub_epi8(a.raw, b.raw) : _mm256_sub_epi16(a.raw, b.raw)};
+        }
+
+        FURY_TARGET_AVX2 friend Vec eq(Vec a, Vec b) {
+            return {sizeof(T) == 1 ? _mm256_cmpeq_epi8(a.raw, b.raw) : _mm256_cmpeq_epi16(a.raw, b.raw)};
+        }
+
+        FURY_TARGET_AVX2 friend bool testz(Vec v) {
+            return _mm256_testz_si256(v.raw, v.raw) != 0;
+        }
+
+        FURY_TARGET_AVX2 friend bool testz(Vec a, Vec b) {
+            return _mm256_testz_si256(a.raw, b.raw) != 0;
+        }
+
+        FURY_TARGET_AVX2 friend uint64_t movemask(Vec v) {
+            if (sizeof(T) == 1) {
+                return static_cast<uint32_t>(_mm256_movemask_epi8(v.raw));
+            }
+            // packs works within 128-bit halves; the permute puts both halves' lanes in order
+            __m256i packed = _mm256_packs_epi16(v.raw, _mm256_setzero_si256());
+            packed = _mm256_permute4x64_epi64(packed, 0xD8);
+            return static_cast<uint32_t>(_mm256_movemask_epi8(packed)) & 0xFFFF;
+        }
+
+        FURY_TARGET_AVX2 friend uint64_t sumLanes(Vec v) {
+            __m256i sums;
+            if (sizeof(T) == 1) {
+                sums = _mm256_sad_epu8(v.raw, _mm256_setzero_si256());
+            } else {
+                __m256i low = _mm256_and_si256(v.raw, _mm256_set1_epi32(0xFFFF));
+                sums = _mm256_add_epi32(low, _mm256_srli_epi32(v.raw, 16));
+                sums = _mm256_add_epi32(sums, _mm256_srli_epi64(sums, 32));
+                sums = _mm256_and_si256(sums, _mm256_set1_epi64x(0xFFFFFFFF));
+            }
+            return _mm256_extract_epi64(sums, 0) + _mm256_extract_epi64(sums, 1) +
+                   _mm256_extract_epi64(sums, 2) + _mm256_extract_epi64(sums, 3);
+        }
+    };
+
+    // Needs AVX-512BW for the 8- and 16-bit lane operations
+    template <typename T>
+    struct Vec<AVX512, T> {
+        static_assert(sizeof(T) == 1 || sizeof(T) == 2, "8- or 16-bit lanes");
+        static constexpr size_t lanes = 64 / sizeof(T);
+        __m512i raw;
+
+        FURY_TARGET_AVX512 static Vec load(const T *data) {
+            return {_mm512_loadu_si512(data)};
+        }
+
+        FURY_TARGET_AVX512 static Vec splat(T value) {
+            return {sizeof(T) == 1 ? _mm512_set1_epi8(static_cast<char>(value))
+                                   : _mm512_set1_epi16(static_cast<short>(value))};
+        }
+
+        FURY_TARGET_AVX512 static Vec zero() {
+            return {_mm512_setzero_si512()};
+        }
+
+        FURY_TARGET_AVX512 void store(T *data) const {
+            _mm512_storeu_si512(data, raw);
+        }
+
+        FURY_TARGET_AVX512 friend Vec operator&(Vec a, Vec b) { return {_mm512_and_si512(a.raw, b.raw)}; }
+        FURY_TARGET_AVX512 friend Vec operator|(Vec a, Vec b) { return {_mm512_or_si512(a.raw, b.raw)}; }
+        FURY_TARGET_AVX512 friend Vec operator^(Vec a, Vec b) { return {_mm512_xor_si512(a.raw, b.raw)}; }
+
+        FURY_TARGET_AVX512 friend Vec operator+(Vec a, Vec b) {
+            return {sizeof(T) == 1 ? _mm512_add_epi8(a.raw, b.raw) : _mm512_add_epi16(a.raw, b.raw)};
+        }
+
+        FURY_TARGET_AVX512 friend Vec operator-(Vec a, Vec b) {
+            return {sizeof(T) == 1 ? _mm512_sub_epi8(a.raw, b.raw) : _mm512_sub_epi16(a.raw, b.raw)};
+        }
+
+        FURY_TARGET_AVX512 friend Vec eq(Vec a, Vec b) {
+            return {sizeof(T) == 1 ? _mm512_movm_epi8(_mm512_cmpeq_epi8_mask(a.raw, b.raw))
+                                   : _mm512_movm_epi16(_mm512_cmpeq_epi16_mask(a.raw, b.raw))};
+        }
+
+        FURY_TARGET_AVX512 friend bool testz(Vec v) {
+            return _mm512_test_epi64_mask(v.raw, v.raw) == 0;
+        }
+
+        FURY_TARGET_AVX512 friend bool testz(Vec a, Vec b) {
+            return _mm512_test_epi64_mask(a.raw, b.raw) == 0;
+        }
+
+        FURY_TARGET_AVX512 friend uint64_t movemask(Vec v) {
+            return sizeof(T) == 1 ? static_cast<uint64_t>(_mm512_movepi8_mask(v.raw))
+                                  : static_cast<uint64_t>(_mm512_movepi16_mask(v.raw));
+        }
+
+        // Byte sums with sad; a 16-bit lane is its low byte plus 256 times its high byte
+        FURY_TARGET_AVX512 friend uint64_t sumLanes(Vec v) {
+            const __m512i zero = _mm512_setzero_si512();
+            uint64_t parts[8];
+            uint64_t sum = 0;
+            if (sizeof(T) == 1) {
+                _mm512_storeu_si512(parts, _mm512_sad_epu8(v.raw, zero));
+                for (uint64_t part : parts) {
+                    sum += part;
+                }
+                return sum;
+            }
+            _mm512_storeu_si512(parts, _mm512_sad_epu8(_mm512_and_si512(v.raw, _mm512_set1_epi16(0x00FF)), zero));
+            for (uint64_t part : parts) {
+                sum += part;
+            }
+            _mm512_storeu_si512(parts, _mm512_sad_epu8(_mm512_and_si512(v.raw, _mm512_set1_epi16(static_cast<short>(0xFF00))), zero));
+            for (uint64_t part : parts) {
+                sum += part << 8;
+            }
+            return sum;
+        }
+    };
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    template <>
+    struct Vec<NEON, uint8_t> {
+        static constexpr size_t lanes = 16;
+        uint8x16_t raw;
+
+        static Vec load(const uint8_t *data) { return {vld1q_u8(data)}; }
+        static Vec splat(uint8_t value) { return {vdupq_n_u8(value)}; }
+        static Vec zero() { return {vdupq_n_u8(0)}; }
+        void store(uint8_t *data) const { vst1q_u8(data, raw); }
+
+        friend Vec operator&(Vec a, Vec b) { return {vandq_u8(a.raw, b.raw)}; }
+        friend Vec operator|(Vec a, Vec b) { return {vorrq_u8(a.raw, b.raw)}; }
+        friend Vec operator^(Vec a, Vec b) { return {veorq_u8(a.raw, b.raw)}; }
+        friend Vec operator+(Vec a, Vec b) { return {vaddq_u8(a.raw, b.raw)}; }
+        friend Vec operator-(Vec a, Vec b) { return {vsubq_u8(a.raw, b.raw)}; }
+        friend Vec eq(Vec a, Vec b) { return {vceqq_u8(a.raw, b.raw)}; }
+        friend bool testz(Vec v) { return vmaxvq_u8(v.raw) == 0; }
+        friend bool testz(Vec a, Vec b) { return testz(a & b); }
+
+        // NEON has no movemask: weight each lane's top bit by its position and add up each half
+        friend uint64_t movemask(Vec v) {
+            static const uint8_t weights[16] = {1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128};
+            uint8x16_t bits = vandq_u8(vreinterpretq_u8_s8(vshrq_n_s8(vreinterpretq_s8_u8(v.raw), 7)),
+                                       vld1q_u8(weights));
+            return vaddv_u8(vget_low_u8(bits)) | (static_cast<uint64_t>(vaddv_u8(vget_high_u8(bits))) << 8);
+        }
+
+        friend uint64_t sumLanes(Vec v) { return vaddlvq_u8(v.raw); }
+    };
+
+    template <>
+    struct Vec<NEON, uint16_t> {
+        static constexpr size_t lanes = 8;
+        uint16x8_t raw;
+
+        static Vec load(const uint16_t *data) { return {vld1q_u16(data)}; }
+        static Vec splat(uint16_t value) { return {vdupq_n_u16(value)}; }
+        static Vec zero() { return {vdupq_n_u16(0)}; }
+        void store(uint16_t *data) const { vst1q_u16(data, raw); }
+
+        friend Vec operator&(Vec a, Vec b) { return {vandq_u16(a.raw, b.raw)}; }
+        friend Vec operator|(Vec a, Vec b) { return {vorrq_u16(a.raw, b.raw)}; }
+        friend Vec operator^(Vec a, Vec b) { return {veorq_u16(a.raw, b.raw)}; }
+        friend Vec operator+(Vec a, Vec b) { return {vaddq_u16(a.raw, b.raw)}; }
+        friend Vec operator-(Vec a, Vec b) { return {vsubq_u16(a.raw, b.raw)}; }
+        friend Vec eq(Vec a, Vec b) { return {vceqq_u16(a.raw, b.raw)}; }
+        friend bool testz(Vec v) { return vmaxvq_u16(v.raw) == 0; }
+        friend bool testz(Vec a, Vec b) { return testz(a & b); }
+
+        friend uint64_t movemask(Vec v) {
+            static const uint16_t weights[8] = {1, 2, 4, 8, 16, 32, 64, 128};
+            uint16x8_t bits = vandq_u16(vreinterpretq_u16_s16(vshrq_n_s16(vreinterpretq_s16_u16(v.raw), 15)),
+                                        vld1q_u16(weights));
+            return vaddvq_u16(bits);
+        }
+
+        friend uint64_t sumLanes(Vec v) { return vaddlvq_u16(v.raw); }
+    };
+#endif
+
+} // namespace simd
+} // namespace fury
+
+#endif // POTIMIZER_VEC_H
@@ -0,0 +1,716 @@
+// Google Benchmark suite for the kernels in SIMD/fury.h and the UTF-16 transcoder.
+//
+// Every kernel runs over the workloads in corpus.h, and over any --corpus=FILE given, at
+// input sizes from 16 B to 64 MB. The scans that stop at the first non-ASCII character also
+// sweep its position, and the transcoders and counters sweep the share of non-ASCII
+// characters. Each result reports bytes/s, plus per-byte hardware counts and IPC when
+// perf_event_open is allowed, or else cycles/byte from the time stamp counter on x86.
+//
+//   build-benchmark/potimizer_benchmark --benchmark_filter='isLatin_.*/CjkText'
+//   build-benchmark/potimizer_benchmark --corpus=dump.json --corpus_seed=7
+//
+// --benchmark_out=FILE --benchmark_out_format=json|csv saves the results. --compare=FILE
+// checks this run against JSON saved from an earlier build, see compare.h, and exits with 1
+// if anything got slower by more than --compare_threshold percent (default 5) and the noise.
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "compare.h"
+#include "corpus.h"
+#include "fury.h"
+#include "perf_counters.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+// As in potimizer.cpp: only the transcoder is compiled for AVX2, and its benchmarks are
+// registered after the CPU check
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx2,bmi,popcnt"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx2,bmi,popcnt")
+#endif
+#include "utf16_to_utf8.h"
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+#define BENCHMARK_HAS_TRANSCODER 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include "utf16_to_utf8.h"
+#define BENCHMARK_HAS_TRANSCODER 1
+#endif
+
+namespace {
+
+    const size_t min_bytes = 16;
+    const size_t max_bytes = 64 << 20;
+
+    uint64_t corpus_seed = 42;
+
+    // What a size sweep reads prefixes of: a generated workload, or a --corpus file
+    struct Source {
+        std::string name;
+        corpus::Charset charset;
+        corpus::Workload workload;
+        const corpus::FileCorpus *file;
+    };
+
+    struct TextView {
+        std::string_view utf8;
+        std::u16string_view utf16;
+    };
+
+    // Sizes are registered source by source, so only one generated text, at least max_bytes
+    // in each encoding, is kept in memory at a time
+    TextView sourceText(const Source &source) {
+        if (source.file != nullptr) {
+            return {source.file->utf8(), source.file->utf16()};
+        }
+        static std::unique_ptr<corpus::Text> text;
+        static corpus::Workload workload;
+        if (!text || workload != source.workload) {
+            text.reset();
+            text.reset(new corpus::Text(corpus::generate(source.workload, max_bytes, corpus_seed)));
+            workload = source.workload;
+        }
+        return {text->utf8, text->utf16};
+    }
+
+    enum class Encoding {
+        Utf8,
+        Utf16,
+        Serialized, // utf16 plus its fury::writeString output in serialized
+    };
+
+    struct Input {
+        std::string utf8;
+        std::u16string utf16;
+        std::string serialized;
+        size_t scanned = 0; // Bytes an early-exit scan reads, when it stops before the end
+
+        size_t bytes(Encoding encoding) const {
+            return encoding == Encoding::Utf8 ? utf8.size() : utf16.size() * sizeof(char16_t);
+        }
+    };
+
+    using Output = std::vector<char>;
+
+    // Which sweeps a kernel takes part in besides input size
+    enum Sweep : unsigned {
+        SweepPosition = 1, // Returns false at the first character outside its class
+        SweepDensity = 2,  // Cost depends on how many characters are non-ASCII
+        AsciiOnly = 4,     // Returns at once on the other mixes
+        Latin1Only = 8,    // Returns at once or is meaningless on CJK and emoji
+        AnyBytes = 16,     // Does not look at the text, so run once on Ascii, without a mix name
+    };
+
+    struct Kernel {
+        const char *name;
+        Encoding encoding;
+        unsigned sweeps;
+        size_t (*run)(const Input &input, Output &out);
+    };
+
+    // Adapters from the kernel signatures in fury.h to Kernel::run
+    template <typename R, R (*fn)(const char *, size_t)>
+    size_t scanUtf8(const Input &input, Output &) {
+        return static_cast<size_t>(fn(input.utf8.data(), input.utf8.size()));
+    }
+
+    template <size_t (*fn)(const uint8_t *, size_t)>
+    size_t scanUtf8Bytes(const Input &input, Output &) {
+        return fn(reinterpret_cast<const uint8_t *>(input.utf8.data()), input.utf8.size());
+    }
+
+    template <typename R, R (*fn)(const char16_t *, size_t)>
+    size_t scanUtf16(const Input &input, Output &) {
+        return static_cast<size_t>(fn(input.utf16.data(), input.utf16.size()));
+    }
+
+    template <fury::Utf16Stats (*fn)(const char16_t *, size_t)>
+    size_t statsUtf16(const Input &input, Output &) {
+        fury::Utf16Stats stats = fn(input.utf16.data(), input.utf16.size());
+        benchmark::DoNotOptimize(stats);
+        return input.utf16.size();
+    }
+
+    template <size_t (*fn)(const char16_t *, size_t, uint8_t *)>
+    size_t convertUtf16(const Input &input, Output &out) {
+        return fn(input.utf16.data(), input.utf16.size(), reinterpret_cast<uint8_t *>(out.data()));
+    }
+
+    template <size_t (*fn)(const uint8_t *, size_t, char16_t *)>
+    size_t convertUtf8(const Input &input, Output &out) {
+        return fn(reinterpret_cast<const uint8_t *>(input.utf8.data()), input.utf8.size(),
+                  reinterpret_cast<char16_t *>(out.data()));
+    }
+
+    template <void (*fn)(const char *, char *, size_t)>
+    size_t mapUtf8(const Input &input, Output &out) {
+        fn(input.utf8.data(), out.data(), input.utf8.size());
+        return input.utf8.size();
+    }
+
+    template <bool (*fn)(const std::string &, std::vector<uint32_t> &)>
+    size_t structurals(const Input &input, Output &) {
+        static std::vector<uint32_t> offsets;
+        fn(input.utf8, offsets);
+        return offsets.size();
+    }
+
+    template <size_t (*fn)(const std::string &, const fury::ByteClass &, size_t)>
+    size_t findDelimiter(const Input &input, Output &) {
+        static const fury::ByteClass delimiters = fury::compileByteClass(std::string("\t\n\r\"\\|~"));
+        return fn(input.utf8, delimiters, 0);
+    }
+
+    template <size_t Width, void (*fn)(const void *, void *, size_t)>
+    size_t swapBytes(const Input &input, Output &out) {
+        fn(input.utf8.data(), out.data(), input.utf8.size() / Width);
+        return input.utf8.size();
+    }
+
+    template <uint64_t (*fn)(const std::string &)>
+    size_t hashUtf8(const Input &input, Output &) {
+        return static_cast<size_t>(fn(input.utf8));
+    }
+
+#if defined(BENCHMARK_HAS_TRANSCODER)
+    size_t transcodeScalar(const Input &input, Output &out) {
+        char *utf8 = out.data();
+        for (size_t i = 0; i < input.utf16.size();) {
+            i = utf16_to_utf8(input.utf16.data(), input.utf16.size(), i, true, utf8);
+        }
+        return utf8 - out.data();
+    }
+
+    size_t transcodeSimd(const Input &input, Output &out) {
+        return utf16_to_utf8_simd(input.utf16.data(), input.utf16.size(), true, out.data()) - out.data();
+    }
+
+    size_t validateUtf16Simd(const Input &input, Output &) {
+        return validate_utf16_simd(input.utf16.data(), input.utf16.size(), true);
+    }
+
+    size_t utf8LengthSimd(const Input &input, Output &) {
+        return utf8_length_simd(input.utf16.data(), input.utf16.size(), true);
+    }
+#endif
+
+    size_t writeString(const Input &input, Output &) {
+        static std::string buffer;
+        buffer.clear();
+        return static_cast<size_t>(fury::writeString(input.utf16, buffer));
+    }
+
+    size_t readString(const Input &input, Output &) {
+        size_t reader_index = 0;
+        return fury::readString(input.serialized, reader_index).size();
+    }
+
+    // Add the Baseline kernel, then each SIMD one this machine can run
+    struct Variants {
+        bool sse2 = false;
+        bool avx2 = false;
+        bool avx512 = false;
+        bool neon = false;
+        bool rvv = false;
+
+        Variants() {
+#if defined(__x86_64__) || defined(_M_X64)
+            sse2 = true;
+            avx2 = fury::cpuSupportsAVX2();
+            avx512 = fury::cpuSupportsAVX512BW();
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+            neon = true;
+#elif defined(FURY_HAS_RVV)
+            rvv = true;
+#endif
+        }
+    };
+
+    std::vector<Kernel> kernels() {
+        const Variants cpu;
+        const unsigned scan = SweepPosition | AsciiOnly;
+        std::vector<Kernel> list;
+
+        list.push_back({"isLatin_Baseline", Encoding::Utf8, scan, scanUtf8<bool, fury::isLatin_Baseline>});
+        if (cpu.sse2) list.push_back({"isLatin_SSE2", Encoding::Utf8, scan, scanUtf8<bool, fury::isLatin_SSE2>});
+        if (cpu.avx2) list.push_back({"isLatin_AVX2", Encoding::Utf8, scan, scanUtf8<bool, fury::isLatin_AVX2>});
+        if (cpu.avx512) list.push_back({"isLatin_AVX512", Encoding::Utf8, scan, scanUtf8<bool, fury::isLatin_AVX512>});
+        if (cpu.neon) list.push_back({"isLatin_NEON", Encoding::Utf8, scan, scanUtf8<bool, fury::isLatin_NEON>});
+        if (cpu.rvv) list.push_back({"isLatin_RISCV", Encoding::Utf8, scan, scanUtf8<bool, fury::isLatin_RISCV>});
+
+        list.push_back({"count_code_points_utf8_Baseline", Encoding::Utf8, SweepDensity,
+                        scanUtf8<size_t, fury::count_code_points_utf8_Baseline>});
+        if (cpu.sse2) list.push_back({"count_code_points_utf8_SSE2", Encoding::Utf8, SweepDensity,
+                                      scanUtf8<size_t, fury::count_code_points_utf8_SSE2>});
+        if (cpu.avx2) list.push_back({"count_code_points_utf8_AVX2", Encoding::Utf8, SweepDensity,
+                                      scanUtf8<size_t, fury::count_code_points_utf8_AVX2>});
+        if (cpu.avx512) list.push_back({"count_code_points_utf8_AVX512", Encoding::Utf8, SweepDensity,
+                                        scanUtf8<size_t, fury::count_code_points_utf8_AVX512>});
+        if (cpu.neon) list.push_back({"count_code_points_utf8_NEON", Encoding::Utf8, SweepDensity,
+                                      scanUtf8<size_t, fury::count_code_points_utf8_NEON>});
+        if (cpu.rvv) list.push_back({"count_code_points_utf8_RISCV", Encoding::Utf8, SweepDensity,
+                                     scanUtf8<size_t, fury::count_code_points_utf8_RISCV>});
+
+        list.push_back({"count_code_points_utf16_Baseline", Encoding::Utf16, SweepDensity,
+                        scanUtf16<size_t, fury::count_code_points_utf16_Baseline>});
+        if (cpu.sse2) list.push_back({"count_code_points_utf16_SSE2", Encoding::Utf16, SweepDensity,
+                                      scanUtf16<size_t, fury::count_code_points_utf16_SSE2>});
+        if (cpu.avx2) list.push_back({"count_code_points_utf16_AVX2", Encoding::Utf16, SweepDensity,
+                                      scanUtf16<size_t, fury::count_code_points_utf16_AVX2>});
+        if (cpu.avx512) list.push_back({"count_code_points_utf16_AVX512", Encoding::Utf16, SweepDensity,
+                                        scanUtf16<size_t, fury::count_code_points_utf16_AVX512>});
+        if (cpu.neon) list.push_back({"count_code_points_utf16_NEON", Encoding::Utf16, SweepDensity,
+                                      scanUtf16<size_t, fury::count_code_points_utf16_NEON>});
+        if (cpu.rvv) list.push_back({"count_code_points_utf16_RISCV", Encoding::Utf16, SweepDensity,
+                                     scanUtf16<size_t, fury::count_code_points_utf16_RISCV>});
+
+        list.push_back({"validateUtf8_Baseline", Encoding::Utf8, SweepDensity, scanUtf8Bytes<fury::validateUtf8_Baseline>});
+        if (cpu.avx2) list.push_back({"validateUtf8_AVX2", Encoding::Utf8, SweepDensity, scanUtf8Bytes<fury::validateUtf8_AVX2>});
+
+        list.push_back({"computeUtf16Stats_Baseline", Encoding::Utf16, SweepDensity, statsUtf16<fury::computeUtf16Stats_Baseline>});
+        if (cpu.avx2) list.push_back({"computeUtf16Stats_AVX2", Encoding::Utf16, SweepDensity, statsUtf16<fury::computeUtf16Stats_AVX2>});
+
+        list.push_back({"isLatin1_Baseline", Encoding::Utf16, SweepPosition | Latin1Only, scanUtf16<bool, fury::isLatin1_Baseline>});
+        if (cpu.avx2) list.push_back({"isLatin1_AVX2", Encoding::Utf16, SweepPosition | Latin1Only, scanUtf16<bool, fury::isLatin1_AVX2>});
+        if (cpu.rvv) list.push_back({"isLatin1_RISCV", Encoding::Utf16, SweepPosition | Latin1Only, scanUtf16<bool, fury::isLatin1_RISCV>});
+
+        list.push_back({"compressLatin1_Baseline", Encoding::Utf16, Latin1Only, convertUtf16<fury::compressLatin1_Baseline>});
+        if (cpu.avx2) list.push_back({"compressLatin1_AVX2", Encoding::Utf16, Latin1Only, convertUtf16<fury::compressLatin1_AVX2>});
+        if (cpu.rvv) list.push_back({"compressLatin1_RISCV", Encoding::Utf16, Latin1Only, convertUtf16<fury::compressLatin1_RISCV>});
+
+        list.push_back({"inflateLatin1_Baseline", Encoding::Utf8, Latin1Only, convertUtf8<fury::inflateLatin1_Baseline>});
+        if (cpu.avx2) list.push_back({"inflateLatin1_AVX2", Encoding::Utf8, Latin1Only, convertUtf8<fury::inflateLatin1_AVX2>});
+        if (cpu.rvv) list.push_back({"inflateLatin1_RISCV", Encoding::Utf8, Latin1Only, convertUtf8<fury::inflateLatin1_RISCV>});
+
+        list.push_back({"utf16ToUtf8_Baseline", Encoding::Utf16, SweepDensity, convertUtf16<fury::utf16ToUtf8_Baseline>});
+        if (cpu.avx2) list.push_back({"utf16ToUtf8_AVX2", Encoding::Utf16, SweepDensity, convertUtf16<fury::utf16ToUtf8_AVX2>});
+
+        list.push_back({"utf8ToUtf16_Baseline", Encoding::Utf8, SweepDensity, convertUtf8<fury::utf8ToUtf16_Baseline>});
+        if (cpu.avx2) list.push_back({"utf8ToUtf16_AVX2", Encoding::Utf8, SweepDensity, convertUtf8<fury::utf8ToUtf16_AVX2>});
+
+        list.push_back({"findStructurals_Baseline", Encoding::Utf8, 0, structurals<fury::findStructurals_Baseline>});
+        if (cpu.avx2) list.push_back({"findStructurals_AVX2", Encoding::Utf8, 0, structurals<fury::findStructurals_AVX2>});
+        if (cpu.neon) list.push_back({"findStructurals_NEON", Encoding::Utf8, 0, structurals<fury::findStructurals_NEON>});
+
+        list.push_back({"findFirstOf_Baseline", Encoding::Utf8, 0, findDelimiter<fury::findFirstOf_Baseline>});
+        if (cpu.avx2) list.push_back({"findFirstOf_AVX2", Encoding::Utf8, 0, findDelimiter<fury::findFirstOf_AVX2>});
+        if (cpu.neon) list.push_back({"findFirstOf_NEON", Encoding::Utf8, 0, findDelimiter<fury::findFirstOf_NEON>});
+
+        list.push_back({"toLowerAscii_Baseline", Encoding::Utf8, 0, mapUtf8<fury::toLowerAscii_Baseline>});
+        if (cpu.avx2) list.push_back({"toLowerAscii_AVX2", Encoding::Utf8, 0, mapUtf8<fury::toLowerAscii_AVX2>});
+        if (cpu.neon) list.push_back({"toLowerAscii_NEON", Encoding::Utf8, 0, mapUtf8<fury::toLowerAscii_NEON>});
+
+        list.push_back({"hashIgnoreCaseAscii_Baseline", Encoding::Utf8, 0, hashUtf8<fury::hashIgnoreCaseAscii_Baseline>});
+        if (cpu.avx2) list.push_back({"hashIgnoreCaseAscii_AVX2", Encoding::Utf8, 0, hashUtf8<fury::hashIgnoreCaseAscii_AVX2>});
+
+#if defined(BENCHMARK_HAS_TRANSCODER)
+        if (cpu.avx2 || cpu.neon) {
+            list.push_back({"utf16_to_utf8_scalar", Encoding::Utf16, SweepDensity, transcodeScalar});
+            list.push_back({"utf16_to_utf8_simd", Encoding::Utf16, SweepDensity, transcodeSimd});
+            list.push_back({"validate_utf16_simd", Encoding::Utf16, SweepDensity, validateUtf16Simd});
+            list.push_back({"utf8_length_simd", Encoding::Utf16, SweepDensity, utf8LengthSimd});
+        }
+#endif
+
+        list.push_back({"byteSwap16_Baseline", Encoding::Utf8, AnyBytes, swapBytes<2, fury::byteSwap16_Baseline>});
+        if (cpu.avx2) list.push_back({"byteSwap16_AVX2", Encoding::Utf8, AnyBytes, swapBytes<2, fury::byteSwap16_AVX2>});
+        if (cpu.neon) list.push_back({"byteSwap16_NEON", Encoding::Utf8, AnyBytes, swapBytes<2, fury::byteSwap16_NEON>});
+        list.push_back({"byteSwap32_Baseline", Encoding::Utf8, AnyBytes, swapBytes<4, fury::byteSwap32_Baseline>});
+        if (cpu.avx2) list.push_back({"byteSwap32_AVX2", Encoding::Utf8, AnyBytes, swapBytes<4, fury::byteSwap32_AVX2>});
+        if (cpu.neon) list.push_back({"byteSwap32_NEON", Encoding::Utf8, AnyBytes, swapBytes<4, fury::byteSwap32_NEON>});
+        list.push_back({"byteSwap64_Baseline", Encoding::Utf8, AnyBytes, swapBytes<8, fury::byteSwap64_Baseline>});
+        if (cpu.avx2) list.push_back({"byteSwap64_AVX2", Encoding::Utf8, AnyBytes, swapBytes<8, fury::byteSwap64_AVX2>});
+        if (cpu.neon) list.push_back({"byteSwap64_NEON", Encoding::Utf8, AnyBytes, swapBytes<8, fury::byteSwap64_NEON>});
+
+        list.push_back({"writeString", Encoding::Utf16, SweepDensity, writeString});
+        list.push_back({"readString", Encoding::Serialized, SweepDensity, readString});
+        return list;
+    }
+
+    void finishInput(Encoding encoding, Input &input) {
+        if (encoding == Encoding::Serialized) {
+            fury::writeString(input.utf16, input.serialized);
+        }
+    }
+
+    // A prefix of about the given size that does not split a character
+    Input sizedInput(const Source &source, Encoding encoding, size_t bytes) {
+        TextView text = sourceText(source);
+        Input input;
+        if (encoding == Encoding::Utf8) {
+            input.utf8 = text.utf8.substr(0, corpus::utf8Prefix(text.utf8, bytes));
+        } else {
+            input.utf16 = text.utf16.substr(0, corpus::utf16Prefix(text.utf16, bytes / 2));
+        }
+        finishInput(encoding, input);
+        return input;
+    }
+
+    // ASCII log text with one character that ends the scan at position percent of the way in,
+    // or none at 100: 'é' for the UTF-8 ASCII scans, U+4E00 for the UTF-16 Latin-1 scans
+    Input positionInput(const Kernel &kernel, size_t bytes, size_t percent) {
+        const Source logs = {"", corpus::Charset::Ascii, corpus::Workload::AsciiLog, nullptr};
+        Input input = sizedInput(logs, kernel.encoding, bytes);
+        if (kernel.encoding == Encoding::Utf8 && percent < 100) {
+            size_t pos = std::min(bytes * percent / 100, input.utf8.size() - 2);
+            input.utf8.replace(pos, 2, "\xc3\xa9");
+            input.scanned = pos + 2;
+        } else if (percent < 100) {
+            size_t pos = std::min(input.utf16.size() * percent / 100, input.utf16.size() - 1);
+            input.utf16[pos] = 0x4E00;
+            input.scanned = (pos + 1) * sizeof(char16_t);
+        }
+
+        // The scans return false (0) when they stop early; if this one read to the end after
+        // all, count the whole input
+        Output out(input.bytes(kernel.encoding) * 2 + 64);
+        if (input.scanned != 0 && kernel.run(input, out) != 0) {
+            input.scanned = 0;
+        }
+        return input;
+    }
+
+    // ASCII text where percent of the characters are CJK, spread at random
+    Input densityInput(Encoding encoding, size_t bytes, size_t percent) {
+        std::mt19937_64 rng(corpus_seed);
+        std::u16string text;
+        while (text.size() < bytes) {
+            uint64_t r = rng();
+            corpus::appendCodePoint(static_cast<uint32_t>(r % 100 < percent ? 0x4E00 + (r >> 8) % 0x5200 : ' ' + (r >> 8) % 95), text);
+        }
+        Input input;
+        if (encoding == Encoding::Utf8) {
+            std::string utf8 = corpus::toUtf8(text);
+            input.utf8 = utf8.substr(0, corpus::utf8Prefix(utf8, bytes));
+        } else {
+            input.utf16 = text.substr(0, corpus::utf16Prefix(text, bytes / 2));
+        }
+        finishInput(encoding, input);
+        return input;
+    }
+
+    uint64_t readCycles() {
+#if defined(__x86_64__) || defined(_M_X64)
+        return __rdtsc();
+#else
+        return 0; // No user-readable cycle counter, cycles/byte is left out
+#endif
+    }
+
+    perf::Counters &perfCounters() {
+        static perf::Counters counters;
+        return counters;
+    }
+
+    // Cycles and hardware counts over one benchmark loop
+    struct Measurement {
+        uint64_t start_cycles;
+        uint64_t cycles = 0;
+        perf::Sample sample;
+
+        Measurement() : start_cycles(readCycles()) {
+            perfCounters().start();
+        }
+
+        void finish() {
+            sample = perfCounters().stop();
+            cycles = readCycles() - start_cycles;
+        }
+    };
+
+    void reportBytes(benchmark::State &state, size_t bytes, const Measurement &measurement) {
+        state.SetBytesProcessed(static_cast<int64_t>(state.iterations() * bytes));
+        double total_bytes = static_cast<double>(state.iterations()) * static_cast<double>(bytes);
+        if (total_bytes == 0) {
+            return;
+        }
+
+        // Core cycles when counted, else TSC reference cycles
+        const perf::Sample &sample = measurement.sample;
+        uint64_t cycles = sample.has(perf::Cycles) ? sample[perf::Cycles] : measurement.cycles;
+        if (cycles != 0) {
+            state.counters["cycles/byte"] = static_cast<double>(cycles) / total_bytes;
+        }
+        if (sample.has(perf::Cycles) && sample.has(perf::Instructions) && sample[perf::Cycles] != 0) {
+            state.counters["IPC"] = static_cast<double>(sample[perf::Instructions]) / static_cast<double>(sample[perf::Cycles]);
+        }
+        for (perf::Event event : {perf::Instructions, perf::BranchMisses, perf::L1Misses, perf::LlcMisses}) {
+            if (sample.has(event)) {
+                state.counters[std::string(perf::eventName(event)) + "/byte"] = static_cast<double>(sample[event]) / total_bytes;
+            }
+        }
+    }
+
+    void runKernel(benchmark::State &state, const Kernel &kernel, const Input &input) {
+        size_t bytes = input.bytes(kernel.encoding);
+        Output out(bytes * 2 + 64); // Enough for every kernel's worst case
+        if (input.scanned != 0) {
+            bytes = input.scanned;
+        }
+
+        Measurement measurement;
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(kernel.run(input, out));
+            benchmark::ClobberMemory();
+        }
+        measurement.finish();
+
+        reportBytes(state, bytes, measurement);
+    }
+
+    // Varints with a uniform bit width up to max_bits, so small values are as common as large
+    std::vector<uint32_t> varintValues(size_t count, uint32_t max_bits) {
+        std::mt19937 rng(42);
+        std::vector<uint32_t> values(count);
+        for (auto &value : values) {
+            uint32_t bits = 1 + rng() % max_bits;
+            value = bits == 32 ? rng() : rng() & ((1u << bits) - 1);
+        }
+        return values;
+    }
+
+    void runVarintEncode(benchmark::State &state) {
+        std::vector<uint32_t> values = varintValues(static_cast<size_t>(state.range(0)), static_cast<uint32_t>(state.range(1)));
+        std::vector<uint8_t> bytes(values.size() * 5 + 8);
+
+        size_t length = 0;
+        Measurement measurement;
+        for (auto _ : state) {
+            length = fury::encodeVarUint32Batch(values.data(), values.size(), bytes.data());
+            benchmark::DoNotOptimize(length);
+            benchmark::ClobberMemory();
+        }
+        measurement.finish();
+        reportBytes(state, length, measurement);
+    }
+
+    template <size_t (*fn)(const uint8_t *, size_t, uint32_t *, size_t)>
+    void runVarintDecode(benchmark::State &state) {
+        std::vector<uint32_t> values = varintValues(static_cast<size_t>(state.range(0)), static_cast<uint32_t>(state.range(1)));
+        std::vector<uint8_t> bytes(values.size() * 5 + 8);
+        size_t length = fury::encodeVarUint32Batch(values.data(), values.size(), bytes.data());
+        std::vector<uint32_t> decoded(values.size());
+
+        Measurement measurement;
+        for (auto _ : state) {
+            benchmark::DoNotOptimize(fn(bytes.data(), length, decoded.data(), decoded.size()));
+            benchmark::ClobberMemory();
+        }
+        measurement.finish();
+        reportBytes(state, length, measurement);
+    }
+
+    // Class and field names: 1024 of the given length, drawn from the characters the 5-bit
+    // (lower case and . _) or 6-bit (letters, digits and . _) MetaString encoding takes
+    std::vector<std::string> metaNames(size_t length, int bits) {
+        const std::string alphabet = bits == 5 ? "abcdefghijklmnopqrstuvwxyz._"
+                                               : "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789._";
+        std::mt19937 rng(42);
+        std::vector<std::string> names(1024);
+        for (auto &name : names) {
+            for (size_t i = 0; i < length; ++i) {
+                name += alphabet[rng() % alphabet.size()];
+            }
+        }
+        return names;
+    }
+
+    template <fury::MetaStringStats (*fn)(const char *, size_t, char, char)>
+    void runMetaStats(benchmark::State &state) {
+        std::vector<std::string> names = metaNames(static_cast<size_t>(state.range(0)), static_cast<int>(state.range(1)));
+
+        Measurement measurement;
+        for (auto _ : state) {
+            for (const std::string &name : names) {
+                fury::MetaStringStats stats = fn(name.data(), name.size(), '.', '_');
+                benchmark::DoNotOptimize(stats);
+            }
+        }
+        measurement.finish();
+        reportBytes(state, names.size() * names[0].size(), measurement);
+    }
+
+    template <void (*fn)(const char *, size_t, int, char, char, uint8_t *)>
+    void runMetaPack(benchmark::State &state) {
+        int bits = static_cast<int>(state.range(1));
+        std::vector<std::string> names = metaNames(static_cast<size_t>(state.range(0)), bits);
+        std::vector<uint8_t> out((names[0].size() * bits + 7) / 8 + 16); // Room for the 16-byte vector stores
+
+        Measurement measurement;
+        for (auto _ : state) {
+            for (const std::string &name : names) {
+                fn(name.data(), name.size(), bits, '.', '_', out.data());
+                benchmark::ClobberMemory();
+            }
+        }
+        measurement.finish();
+        reportBytes(state, names.size() * names[0].size(), measurement);
+    }
+
+    void registerBenchmarks(const std::vector<Source> &sources) {
+        std::vector<Kernel> list = kernels();
+
+        // Input size, source by source so only one generated text is held at a time
+        for (const Source &source : sources) {
+            size_t largest = max_bytes;
+            if (source.file != nullptr) {
+                largest = std::min(largest, std::max(source.file->utf8().size(), source.file->utf16().size() * 2));
+                largest = std::max(largest, min_bytes);
+            }
+            for (const Kernel &kernel : list) {
+                if ((kernel.sweeps & Latin1Only) && source.charset == corpus::Charset::Unicode) {
+                    continue;
+                }
+                if ((kernel.sweeps & AsciiOnly) && source.charset != corpus::Charset::Ascii) {
+                    continue;
+                }
+                if ((kernel.sweeps & AnyBytes) && &source != &sources.front()) {
+                    continue;
+                }
+                std::string name = kernel.name;
+                if (!(kernel.sweeps & AnyBytes)) {
+                    name = name + "/" + source.name;
+                }
+                benchmark::RegisterBenchmark(name.c_str(), [kernel, source](benchmark::State &state) {
+                    runKernel(state, kernel, sizedInput(source, kernel.encoding, static_cast<size_t>(state.range(0))));
+                })->RangeMultiplier(4)->Range(static_cast<int64_t>(min_bytes), static_cast<int64_t>(largest))->ArgName("bytes");
+            }
+        }
+
+        for (const Kernel &kernel : list) {
+            if (kernel.sweeps & SweepPosition) {
+                std::string name = std::string(kernel.name) + "/position";
+                benchmark::RegisterBenchmark(name.c_str(), [kernel](benchmark::State &state) {
+                    runKernel(state, kernel, positionInput(kernel, static_cast<size_t>(state.range(0)),
+                                                           static_cast<size_t>(state.range(1))));
+                })->ArgsProduct({{4 << 10, 1 << 20}, {0, 10, 25, 50, 75, 90, 100}})->ArgNames({"bytes", "percent"});
+            }
+        }
+
+        for (const Kernel &kernel : list) {
+            if (kernel.sweeps & SweepDensity) {
+                std::string name = std::string(kernel.name) + "/density";
+                benchmark::RegisterBenchmark(name.c_str(), [kernel](benchmark::State &state) {
+                    runKernel(state, kernel, densityInput(kernel.encoding, static_cast<size_t>(state.range(0)),
+                                                          static_cast<size_t>(state.range(1))));
+                })->ArgsProduct({{64 << 10}, {0, 1, 5, 10, 25, 50, 100}})->ArgNames({"bytes", "percent"});
+            }
+        }
+
+        // Varints by value count and bit width: 7 bits is one byte each, 32 up to five
+        const std::vector<std::vector<int64_t>> varint_args = {{16, 1 << 10, 1 << 16, 1 << 20}, {7, 14, 21, 32}};
+        benchmark::RegisterBenchmark("encodeVarUint32Batch", runVarintEncode)->ArgsProduct(varint_args)->ArgNames({"values", "bits"});
+        benchmark::RegisterBenchmark("decodeVarUint32Batch_Baseline", runVarintDecode<fury::decodeVarUint32Batch_Baseline>)
+                ->ArgsProduct(varint_args)->ArgNames({"values", "bits"});
+        if (Variants().avx2) {
+            benchmark::RegisterBenchmark("decodeVarUint32Batch_AVX2", runVarintDecode<fury::decodeVarUint32Batch_AVX2>)
+                    ->ArgsProduct(varint_args)->ArgNames({"values", "bits"});
+        }
+
+        // MetaString name encoding, mostly at the short lengths real names have
+        const std::vector<std::vector<int64_t>> meta_args = {{4, 8, 16, 32, 64, 256}, {5, 6}};
+        benchmark::RegisterBenchmark("computeMetaStringStats_Baseline", runMetaStats<fury::computeMetaStringStats_Baseline>)
+                ->ArgsProduct(meta_args)->ArgNames({"chars", "bits"});
+        benchmark::RegisterBenchmark("packMetaChars_Baseline", runMetaPack<fury::packMetaChars_Baseline>)
+                ->ArgsProduct(meta_args)->ArgNames({"chars", "bits"});
+        if (Variants().avx2) {
+            benchmark::RegisterBenchmark("computeMetaStringStats_AVX2", runMetaStats<fury::computeMetaStringStats_AVX2>)
+                    ->ArgsProduct(meta_args)->ArgNames({"chars", "bits"});
+            benchmark::RegisterBenchmark("packMetaChars_AVX2", runMetaPack<fury::packMetaChars_AVX2>)
+                    ->ArgsProduct(meta_args)->ArgNames({"chars", "bits"});
+        }
+    }
+
+} // namespace
+
+int main(int argc, char **argv) {
+    // Take our own flags out of argv before Google Benchmark parses it
+    std::vector<std::string> paths;
+    std::string baseline_path;
+    double threshold = 0.05;
+    bool repetitions = false;
+    for (int i = 1; i < argc;) {
+        if (std::strncmp(argv[i], "--corpus=", 9) == 0) {
+            paths.emplace_back(argv[i] + 9);
+        } else if (std::strncmp(argv[i], "--corpus_seed=", 14) == 0) {
+            corpus_seed = std::stoull(argv[i] + 14);
+        } else if (std::strncmp(argv[i], "--compare=", 10) == 0) {
+            baseline_path = argv[i] + 10;
+        } else if (std::strncmp(argv[i], "--compare_threshold=", 20) == 0) {
+            threshold = std::stod(argv[i] + 20) / 100;
+        } else {
+            repetitions = repetitions || std::strncmp(argv[i], "--benchmark_repetitions=", 24) == 0;
+            ++i;
+            continue;
+        }
+        std::copy(argv + i + 1, argv + argc, argv + i);
+        --argc;
+    }
+
+    compare::Results baseline;
+    if (!baseline_path.empty()) {
+        try {
+            baseline = compare::load(baseline_path);
+        } catch (const std::exception &e) {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+    }
+
+    std::vector<Source> sources;
+    for (corpus::Workload workload : corpus::workloads) {
+        sources.push_back({corpus::workloadName(workload), corpus::workloadCharset(workload), workload, nullptr});
+    }
+    std::vector<std::unique_ptr<corpus::FileCorpus>> files;
+    for (const std::string &path : paths) {
+        try {
+            files.emplace_back(new corpus::FileCorpus(path));
+        } catch (const std::exception &e) {
+            std::cerr << e.what() << std::endl;
+            return 1;
+        }
+        std::string name = path.substr(path.find_last_of("/\\") + 1);
+        sources.push_back({"file:" + name, files.back()->charset(), corpus::Workload::AsciiLog, files.back().get()});
+    }
+
+    registerBenchmarks(sources);
+    benchmark::AddCustomContext("corpus_seed", std::to_string(corpus_seed));
+    benchmark::AddCustomContext("perf_counters", perfCounters().status());
+
+    // A median and its noise need a few samples on this side too
+    std::vector<char *> args(argv, argv + argc);
+    char default_repetitions[] = "--benchmark_repetitions=5";
+    if (!baseline_path.empty() && !repetitions) {
+        args.push_back(default_repetitions);
+    }
+    args.push_back(nullptr);
+    argc = static_cast<int>(args.size()) - 1;
+    argv = args.data();
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+        return 1;
+    }
+    if (baseline_path.empty()) {
+        benchmark::RunSpecifiedBenchmarks();
+        benchmark::Shutdown();
+        return 0;
+    }
+    compare::Collector collector;
+    benchmark::RunSpecifiedBenchmarks(&collector);
+    benchmark::Shutdown();
+    return compare::report(baseline, collector.results(), threshold, std::cout) > 0 ? 1 : 0;
+}
@@ -0,0 +1,369 @@
+// Regression check against a saved run: --compare=BASELINE reads the JSON that
+// --benchmark_out wrote for an earlier build, and after this run prints every benchmark
+// whose median time moved by more than both the threshold and the noise.
+//
+// Noise comes from the repetitions on each side: the median absolute deviation, scaled by
+// 1.4826 to estimate a standard deviation, with the two sides added in quadrature. A change
+// only counts when it is larger than three times that, so a noisy benchmark needs a bigger
+// move to fail the check than a steady one. Runs without repetitions have no noise estimate
+// and are judged on the threshold alone.
+#ifndef POTIMIZER_COMPARE_H
+#define POTIMIZER_COMPARE_H
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <ostream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include <benchmark/benchmark.h>
+
+namespace compare {
+
+    // Real time per iteration in nanoseconds, one entry per repetition. Results written with
+    // --benchmark_report_aggregates_only only have the median aggregate.
+    struct Result {
+        std::vector<double> samples;
+        double aggregate_median = -1;
+    };
+
+    using Results = std::map<std::string, Result>;
+
+    inline double median(std::vector<double> values) {
+        std::sort(values.begin(), values.end());
+        size_t middle = values.size() / 2;
+        return values.size() % 2 ? values[middle] : (values[middle - 1] + values[middle]) / 2;
+    }
+
+    inline double medianAbsoluteDeviation(const std::vector<double> &values) {
+        double center = median(values);
+        std::vector<double> deviations;
+        deviations.reserve(values.size());
+        for (double value : values) {
+            deviations.push_back(std::fabs(value - center));
+        }
+        return median(deviations);
+    }
+
+    inline double toNanoseconds(double time, const std::string &unit) {
+        if (unit == "us") {
+            return time * 1e3;
+        }
+        if (unit == "ms") {
+            return time * 1e6;
+        }
+        if (unit == "s") {
+            return time * 1e9;
+        }
+        return time;
+    }
+
+    inline void add(Results &results, const std::string &name, bool aggregate, const std::string &aggregate_name,
+                    double time_ns) {
+        if (!aggregate) {
+            results[name].samples.push_back(time_ns);
+        } else if (aggregate_name == "median") {
+            results[name].aggregate_median = time_ns;
+        }
+    }
+
+    // Just enough JSON for Google Benchmark's output: the scalar fields of each object in the
+    // top-level "benchmarks" array, as text. Everything else is skipped.
+    class JsonReader {
+    public:
+        explicit JsonReader(std::string text) : text_(std::move(text)) {}
+
+        std::vector<std::map<std::string, std::string>> benchmarks() {
+            std::vector<std::map<std::string, std::string>> list;
+            expect('{');
+            while (!consume('}')) {
+                std::string key = quoted();
+                expect(':');
+                if (key != "benchmarks") {
+                    skipValue();
+                } else {
+                    expect('[');
+                    while (!consume(']')) {
+                        list.push_back(object());
+                        consume(',');
+                    }
+                }
+                consume(',');
+            }
+            return list;
+        }
+
+    private:
+        std::map<std::string, std::string> object() {
+            std::map<std::string, std::string> fields;
+            expect('{');
+            while (!consume('}')) {
+                std::string key = quoted();
+                expect(':');
+                skipSpace();
+                if (peek() == '{' || peek() == '[') {
+                    skipValue();
+                } else if (peek() == '"') {
+                    fields[key] = quoted();
+                } else {
+                    fields[key] = scalar();
+                }
+                consume(',');
+            }
+            return fields;
+        }
+
+        void skipValue() {
+            skipSpace();
+            char c = peek();
+            if (c == '{' || c == '[') {
+                char close = c == '{' ? '}' : ']';
+                ++pos_;
+                while (!consume(close)) {
+                    if (c == '{') {
+                        quoted();
+                        expect(':');
+                    }
+                    skipValue();
+                    consume(',');
+                }
+            } else if (c == '"') {
+                quoted();
+            } else {
+                scalar();
+            }
+        }
+
+        std::string quoted() {
+            expect('"');
+            std::string value;
+            while (peek() != '"') {
+                char c = text_[pos_++];
+                if (c != '\\') {
+                    value += c;
+                    continue;
+                }
+                c = peek();
+                ++pos_;
+                switch (c) {
+                case 'n':
+                    value += '\n';
+                    break;
+                case 't':
+                    value += '\t';
+                    break;
+                case 'r':
+                    value += '\r';
+                    break;
+                case 'b':
+                    value += '\b';
+                    break;
+                case 'f':
+                    value += '\f';
+                    break;
+                case 'u': {
+                    // Names are ASCII; anything else only has to survive as a unique key
+                    if (pos_ + 4 > text_.size()) {
+                        fail();
+                    }
+                    unsigned code = static_cast<unsigned>(std::strtoul(text_.substr(pos_, 4).c_str(), nullptr, 16));
+                    pos_ += 4;
+                    value += code < 0x80 ? std::string(1, static_cast<char>(code)) : "\\u" + text_.substr(pos_ - 4, 4);
+                    break;
+                }
+                default:
+                    value += c;
+                    break;
+                }
+            }
+            ++pos_;
+            return value;
+        }
+
+        std::string scalar() {
+            size_t start = pos_;
+            while (pos_ < text_.size() && text_[pos_] != ',' && text_[pos_] != '}' && text_[pos_] != ']' &&
+                   !std::isspace(static_cast<unsigned char>(text_[pos_]))) {
+                ++pos_;
+            }
+            if (pos_ == start) {
+                fail();
+            }
+            return text_.substr(start, pos_ - start);
+        }
+
+        void skipSpace() {
+            while (pos_ < text_.size() && std::isspace(static_cast<unsigned char>(text_[pos_]))) {
+                ++pos_;
+            }
+        }
+
+        char peek() {
+            if (pos_ >= text_.size()) {
+                fail();
+            }
+            return text_[pos_];
+        }
+
+        bool consume(char c) {
+            skipSpace();
+            if (peek() != c) {
+                return false;
+            }
+            ++pos_;
+            return true;
+        }
+
+        void expect(char c) {
+            if (!consume(c)) {
+                fail();
+            }
+        }
+
+        [[noreturn]] void fail() const {
+            throw std::runtime_error("malformed JSON at offset " + std::to_string(pos_));
+        }
+
+        std::string text_;
+        size_t pos_ = 0;
+    };
+
+    // Reads the file --benchmark_out=PATH --benchmark_out_format=json wrote
+    inline Results load(const std::string &path) {
+        std::ifstream file(path, std::ios::binary);
+        if (!file) {
+            throw std::runtime_error("Cannot open " + path);
+        }
+        std::stringstream buffer;
+        buffer << file.rdbuf();
+
+        Results results;
+        try {
+            for (const auto &fields : JsonReader(buffer.str()).benchmarks()) {
+                auto field = [&fields](const char *key) {
+                    auto it = fields.find(key);
+                    return it == fields.end() ? std::string() : it->second;
+                };
+                if (field("error_occurred") == "true" || field("real_time").empty()) {
+                    continue;
+                }
+                std::string name = field("run_name").empty() ? field("name") : field("run_name");
+                add(results, name, field("run_type") == "aggregate", field("aggregate_name"),
+                    toNanoseconds(std::strtod(field("real_time").c_str(), nullptr), field("time_unit")));
+            }
+        } catch (const std::runtime_error &e) {
+            throw std::runtime_error(path + ": " + e.what());
+        }
+        if (results.empty()) {
+            throw std::runtime_error(path + ": no benchmark results");
+        }
+        return results;
+    }
+
+    // The console reporter, also keeping what it prints for the comparison. Colored only on a
+    // terminal, like the default reporter with --benchmark_color=auto.
+    class Collector : public benchmark::ConsoleReporter {
+    public:
+        Collector() : ConsoleReporter(isTerminal() ? OO_Defaults : OO_Tabular) {}
+
+        void ReportRuns(const std::vector<Run> &reports) override {
+            for (const Run &run : reports) {
+                if (!run.error_occurred) {
+                    add(results_, run.run_name.str(), run.run_type == Run::RT_Aggregate, run.aggregate_name,
+                        run.GetAdjustedRealTime() * 1e9 / benchmark::GetTimeUnitMultiplier(run.time_unit));
+                }
+            }
+            ConsoleReporter::ReportRuns(reports);
+        }
+
+        const Results &results() const {
+            return results_;
+        }
+
+    private:
+        static bool isTerminal() {
+#if defined(_WIN32)
+            return _isatty(_fileno(stdout)) != 0;
+#else
+            return isatty(STDOUT_FILENO) != 0;
+#endif
+        }
+
+        Results results_;
+    };
+
+    // Prints the benchmarks that changed and returns how many got slower
+    inline size_t report(const Results &baseline, const Results &current, double threshold, std::ostream &out) {
+        size_t compared = 0;
+        size_t regressions = 0;
+        size_t improvements = 0;
+        size_t missing = 0;
+        std::vector<std::string> lines;
+        for (const auto &entry : current) {
+            auto base = baseline.find(entry.first);
+            if (base == baseline.end()) {
+                ++missing;
+                continue;
+            }
+            const Result &before = base->second;
+            const Result &after = entry.second;
+            double old_ns = before.samples.empty() ? before.aggregate_median : median(before.samples);
+            double new_ns = after.samples.empty() ? after.aggregate_median : median(after.samples);
+            if (old_ns <= 0 || new_ns < 0) {
+                continue;
+            }
+            ++compared;
+
+            double noise = 0;
+            for (const Result *side : {&before, &after}) {
+                if (side->samples.size() >= 2) {
+                    double sigma = 1.4826 * medianAbsoluteDeviation(side->samples);
+                    noise += sigma * sigma;
+                }
+            }
+            noise = 3 * std::sqrt(noise) / old_ns;
+            double delta = (new_ns - old_ns) / old_ns;
+            if (std::fabs(delta) <= threshold || std::fabs(delta) <= noise) {
+                continue;
+            }
+            delta > 0 ? ++regressions : ++improvements;
+
+            char line[160];
+            std::snprintf(line, sizeof(line), "%12.1f %12.1f %+8.1f%% %7.1f%%  %s", old_ns, new_ns, delta * 100,
+                          noise * 100, delta > 0 ? "SLOWER" : "faster");
+            lines.push_back(std::string(line) + "  " + entry.first);
+        }
+
+        out << "\nComparison with baseline (median real time in ns, noise = 3 x scaled MAD)\n";
+        if (!lines.empty()) {
+            out << "    baseline      current    delta   noise\n";
+            for (const std::string &line : lines) {
+                out << line << '\n';
+            }
+        }
+        out << compared << " compared, " << regressions << " slower, " << improvements << " faster beyond "
+            << threshold * 100 << "%";
+        if (missing > 0) {
+            out << ", " << missing << " not in the baseline";
+        }
+        out << std::endl;
+        return regressions;
+    }
+
+} // namespace compare
+
+#endif // POTIMIZER_COMPARE_H
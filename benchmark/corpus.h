@@ -0,0 +1,519 @@
+// Benchmark workloads: seeded text generators that look like production traffic, and a
+// loader that maps a corpus file from disk.
+//
+// Each generator appends whole records (a log line, a sentence, a chat message, a JSON
+// object) until the text is long enough, so every prefix looks like the start of a real
+// stream. The same seed gives the same text everywhere: only raw mt19937_64 output is used,
+// never the std distributions, whose results differ between standard libraries.
+//
+// The word lists are UTF-16 literals in a UTF-8 source file; MSVC needs /utf-8.
+#ifndef POTIMIZER_CORPUS_H
+#define POTIMIZER_CORPUS_H
+
+#include <cstdint>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#if defined(_WIN32)
+#include <fstream>
+#include <sstream>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "fury.h"
+
+namespace corpus {
+
+    enum class Workload {
+        AsciiLog,   // Service logs: timestamps, paths, key=value fields, hex ids
+        Latin1Text, // French, German, Spanish and Portuguese prose, all within Latin-1
+        CjkText,    // Chinese prose with full-width punctuation and some ASCII
+        EmojiChat,  // Short chat messages with emoji, including ZWJ and VS16 sequences
+        MixedJson,  // JSON records whose string fields come from the other workloads
+    };
+
+    const Workload workloads[] = {Workload::AsciiLog, Workload::Latin1Text, Workload::CjkText, Workload::EmojiChat,
+                                  Workload::MixedJson};
+
+    inline const char *workloadName(Workload workload) {
+        switch (workload) {
+        case Workload::AsciiLog:
+            return "AsciiLog";
+        case Workload::Latin1Text:
+            return "Latin1Text";
+        case Workload::CjkText:
+            return "CjkText";
+        case Workload::EmojiChat:
+            return "EmojiChat";
+        default:
+            return "MixedJson";
+        }
+    }
+
+    // The widest characters a text holds, so callers can skip kernels that would return at
+    // the first character
+    enum class Charset { Ascii, Latin1, Unicode };
+
+    inline Charset workloadCharset(Workload workload) {
+        return workload == Workload::AsciiLog ? Charset::Ascii
+               : workload == Workload::Latin1Text ? Charset::Latin1
+                                                  : Charset::Unicode;
+    }
+
+    inline void appendCodePoint(uint32_t code_point, std::u16string &out) {
+        if (code_point < 0x10000) {
+            out += static_cast<char16_t>(code_point);
+        } else {
+            code_point -= 0x10000;
+            out += static_cast<char16_t>(0xD800 + (code_point >> 10));
+            out += static_cast<char16_t>(0xDC00 + (code_point & 0x3FF));
+        }
+    }
+
+    inline void appendUtf8(std::u16string_view utf16, std::string &out) {
+        size_t start = out.size();
+        out.resize(start + utf16.size() * 3);
+        uint8_t *begin = reinterpret_cast<uint8_t *>(&out[0]);
+        uint8_t *end = begin + start;
+        for (size_t i = 0; i < utf16.size();) {
+            i = fury::encodeUtf8Char(utf16.data(), utf16.size(), i, end);
+        }
+        out.resize(end - begin);
+    }
+
+    inline std::string toUtf8(std::u16string_view utf16) {
+        std::string utf8;
+        appendUtf8(utf16, utf8);
+        return utf8;
+    }
+
+    // Throws std::runtime_error on malformed UTF-8
+    inline std::u16string toUtf16(std::string_view utf8) {
+        std::u16string utf16(utf8.size(), u'\0');
+        utf16.resize(fury::utf8ToUtf16(reinterpret_cast<const uint8_t *>(utf8.data()), utf8.size(), &utf16[0]));
+        return utf16;
+    }
+
+    // Longest prefix of at most max_bytes that does not split a UTF-8 sequence
+    inline size_t utf8Prefix(std::string_view utf8, size_t max_bytes) {
+        if (utf8.size() <= max_bytes) {
+            return utf8.size();
+        }
+        size_t end = max_bytes;
+        for (int k = 0; k < 3 && end > 0 && (static_cast<unsigned char>(utf8[end]) & 0xC0) == 0x80; ++k) {
+            --end;
+        }
+        return end;
+    }
+
+    // Longest prefix of at most max_units that does not split a surrogate pair
+    inline size_t utf16Prefix(std::u16string_view utf16, size_t max_units) {
+        if (utf16.size() <= max_units) {
+            return utf16.size();
+        }
+        if (max_units > 0 && (utf16[max_units] & 0xFC00) == 0xDC00 && (utf16[max_units - 1] & 0xFC00) == 0xD800) {
+            return max_units - 1;
+        }
+        return max_units;
+    }
+
+    // A text in both encodings
+    struct Text {
+        std::string utf8;
+        std::u16string utf16;
+    };
+
+    class Generator {
+    public:
+        explicit Generator(uint64_t seed) : rng_(seed) {}
+
+        // Append one record of the workload
+        void record(Workload workload, std::u16string &out) {
+            switch (workload) {
+            case Workload::AsciiLog:
+                logLine(out);
+                break;
+            case Workload::Latin1Text:
+                latin1Sentence(out);
+                break;
+            case Workload::CjkText:
+                cjkSentence(out);
+                break;
+            case Workload::EmojiChat:
+                chatMessage(out);
+                break;
+            default:
+                jsonRecord(out);
+                break;
+            }
+        }
+
+    private:
+        uint64_t next(uint64_t bound) {
+            return rng_() % bound;
+        }
+
+        template <typename T, size_t N>
+        const T &pick(const T (&items)[N]) {
+            return items[next(N)];
+        }
+
+        static void append(const char *ascii, std::u16string &out) {
+            while (*ascii != '\0') {
+                out += static_cast<char16_t>(*ascii++);
+            }
+        }
+
+        static void appendNumber(uint64_t value, int width, std::u16string &out) {
+            char digits[24];
+            int len = 0;
+            do {
+                digits[len++] = static_cast<char>('0' + value % 10);
+                value /= 10;
+            } while (value != 0);
+            for (; len < width; ++len) {
+                digits[len] = '0';
+            }
+            while (len > 0) {
+                out += static_cast<char16_t>(digits[--len]);
+            }
+        }
+
+        void appendHex(int digits, std::u16string &out) {
+            for (int i = 0; i < digits; ++i) {
+                out += static_cast<char16_t>("0123456789abcdef"[next(16)]);
+            }
+        }
+
+        // 2024-07-01T12:34:56.789Z INFO  [worker-7] GET /api/v1/orders/48213 status=200 ...
+        void logLine(std::u16string &out) {
+            static const char *const levels[] = {"INFO ", "INFO ", "INFO ", "INFO ", "INFO ", "INFO ", "INFO ",
+                                                 "INFO ", "DEBUG", "WARN ", "ERROR"};
+            static const char *const methods[] = {"GET", "GET", "GET", "POST", "PUT", "DELETE"};
+            static const char *const paths[] = {"/api/v1/orders/", "/api/v1/users/", "/api/v2/search?q=", "/static/js/app.",
+                                                "/healthz?probe=", "/api/v1/cart/items/"};
+            static const int statuses[] = {200, 200, 200, 200, 200, 200, 201, 204, 301, 304, 400, 404, 500, 503};
+
+            millis_ += 1 + next(250);
+            uint64_t seconds = millis_ / 1000;
+            append("2024-07-01T", out);
+            appendNumber(seconds / 3600 % 24, 2, out);
+            out += u':';
+            appendNumber(seconds / 60 % 60, 2, out);
+            out += u':';
+            appendNumber(seconds % 60, 2, out);
+            out += u'.';
+            appendNumber(millis_ % 1000, 3, out);
+            append("Z ", out);
+            append(pick(levels), out);
+            append(" [worker-", out);
+            appendNumber(next(32), 0, out);
+            append("] ", out);
+            append(pick(methods), out);
+            out += u' ';
+            append(pick(paths), out);
+            appendNumber(next(100000), 0, out);
+            append(" status=", out);
+            appendNumber(static_cast<uint64_t>(pick(statuses)), 0, out);
+            append(" bytes=", out);
+            appendNumber(next(next(8) == 0 ? 1000000 : 20000), 0, out);
+            append(" latency_ms=", out);
+            appendNumber(next(next(20) == 0 ? 5000 : 80), 0, out);
+            append(" trace=", out);
+            appendHex(16, out);
+            out += u'\n';
+        }
+
+        void latin1Sentence(std::u16string &out) {
+            static const char16_t *const words[] = {
+                    u"le", u"la", u"les", u"de", u"des", u"et", u"à", u"où", u"été", u"très", u"déjà", u"élève",
+                    u"garçon", u"français", u"café", u"crème", u"naïve", u"Noël", u"der", u"die", u"das", u"und",
+                    u"für", u"über", u"schön", u"Straße", u"Größe", u"können", u"Müller", u"Zürich", u"Köln",
+                    u"el", u"los", u"que", u"en", u"año", u"niño", u"señor", u"mañana", u"corazón", u"canción",
+                    u"está", u"más", u"o", u"não", u"ação", u"coração", u"também", u"São", u"Paulo", u"você",
+                    u"city", u"the", u"of", u"in", u"is", u"2024", u"Genève", u"Ålesund", u"Øresund"};
+            size_t count = 4 + next(14);
+            for (size_t i = 0; i < count; ++i) {
+                std::u16string word = pick(words);
+                if (i == 0 && word[0] >= u'a' && word[0] <= u'z') {
+                    word[0] = static_cast<char16_t>(word[0] - 32);
+                }
+                out += word;
+                out += i + 1 == count ? (next(6) == 0 ? u'?' : u'.') : (next(8) == 0 ? u',' : u' ');
+                if (i + 1 < count && out.back() == u',') {
+                    out += u' ';
+                }
+            }
+            out += next(5) == 0 ? u'\n' : u' ';
+        }
+
+        void cjkSentence(std::u16string &out) {
+            // Some of the most frequent Han characters in modern Chinese
+            static const char16_t common[] = u"的一是不了人我在有他这中大来上国个到说们为子和你地出道也时年得就那要下以生会"
+                                             u"自着去之过家学对可里后小么心多天而能好都然没日于起还发成事只作当想看文无开手"
+                                             u"十用主行方又如前所本见经头面公同三已老从动两长知民样现分将外但身些与高意进把"
+                                             u"法此实回二理美点月明其种声全工己话儿者向情部正名定女问力机给等几很业最间新什";
+            size_t clauses = 1 + next(4);
+            for (size_t c = 0; c < clauses; ++c) {
+                size_t count = 3 + next(12);
+                for (size_t i = 0; i < count; ++i) {
+                    if (next(40) == 0) {
+                        appendNumber(next(2030), 0, out); // Years and counts are written in ASCII
+                    } else {
+                        out += common[next(sizeof(common) / sizeof(common[0]) - 1)];
+                    }
+                }
+                out += c + 1 == clauses ? (next(8) == 0 ? u'？' : u'。') : (next(4) == 0 ? u'、' : u'，');
+            }
+            if (next(6) == 0) {
+                out += u'\n';
+            }
+        }
+
+        void chatMessage(std::u16string &out) {
+            static const char *const words[] = {"lol", "ok", "see", "you", "at", "the", "party", "tonight", "thanks",
+                                                "so", "much", "haha", "omg", "yes", "no", "maybe", "love", "it",
+                                                "great", "job", "on", "my", "way", "brb", "nice", "what", "time"};
+            static const char16_t *const emoji[] = {u"😂", u"❤️", u"👍", u"🔥", u"🙏", u"😊", u"🎉", u"😭", u"🥰",
+                                                    u"👀", u"✨", u"🤔", u"👍🏽", u"👨‍👩‍👧", u"🏳️‍🌈", u"😅"};
+            append("user", out);
+            appendNumber(next(500), 0, out);
+            append(": ", out);
+            size_t count = 1 + next(10);
+            for (size_t i = 0; i < count; ++i) {
+                if (next(3) == 0) {
+                    out += pick(emoji);
+                    if (next(3) == 0) {
+                        out += pick(emoji); // Emoji often come in runs
+                    }
+                } else {
+                    append(pick(words), out);
+                }
+                out += i + 1 == count ? u'\n' : u' ';
+            }
+        }
+
+        static void appendJsonString(const std::u16string &value, std::u16string &out) {
+            out += u'"';
+            for (char16_t c : value) {
+                if (c == u'"' || c == u'\\') {
+                    out += u'\\';
+                    out += c;
+                } else if (c == u'\n') {
+                    out += u"\\n";
+                } else {
+                    out += c;
+                }
+            }
+            out += u'"';
+        }
+
+        // {"id":48213,"user":"user17","city":"Zürich","message":"...","tags":["..."],"score":0.87}
+        void jsonRecord(std::u16string &out) {
+            static const char16_t *const cities[] = {u"Zürich", u"São Paulo", u"Köln", u"Genève", u"München",
+                                                     u"上海", u"北京", u"東京", u"London", u"New York", u"Málaga"};
+            static const char *const tags[] = {"new", "vip", "mobile", "web", "beta", "sale", "returning"};
+            static const Workload sources[] = {Workload::Latin1Text, Workload::CjkText, Workload::EmojiChat};
+
+            append("{\"id\":", out);
+            appendNumber(next(10000000), 0, out);
+            append(",\"user\":\"user", out);
+            appendNumber(next(100000), 0, out);
+            append("\",\"city\":", out);
+            appendJsonString(pick(cities), out);
+            append(",\"message\":", out);
+            std::u16string message;
+            record(pick(sources), message);
+            while (!message.empty() && (message.back() == u'\n' || message.back() == u' ')) {
+                message.pop_back();
+            }
+            appendJsonString(message, out);
+            append(",\"tags\":[", out);
+            size_t tag_count = next(4);
+            for (size_t i = 0; i < tag_count; ++i) {
+                out += u'"';
+                append(pick(tags), out);
+                out += i + 1 == tag_count ? u"\"" : u"\",";
+            }
+            append("],\"score\":0.", out);
+            appendNumber(next(100), 2, out);
+            append("}\n", out);
+        }
+
+        std::mt19937_64 rng_;
+        uint64_t millis_ = 0;
+    };
+
+    // Whole records of the workload until both encodings hold at least min_bytes
+    inline Text generate(Workload workload, size_t min_bytes, uint64_t seed = 42) {
+        Generator generator(seed);
+        Text text;
+        std::u16string record;
+        while (text.utf8.size() < min_bytes || text.utf16.size() * sizeof(char16_t) < min_bytes) {
+            record.clear();
+            generator.record(workload, record);
+            text.utf16 += record;
+            appendUtf8(record, text.utf8);
+        }
+        return text;
+    }
+
+    // A read-only view of a whole file. POSIX systems map it; elsewhere it is read into memory.
+    class MappedFile {
+    public:
+        explicit MappedFile(const std::string &path) {
+#if defined(_WIN32)
+            std::ifstream in(path, std::ios::binary);
+            if (!in) {
+                throw std::runtime_error("Cannot open " + path);
+            }
+            std::ostringstream contents;
+            contents << in.rdbuf();
+            contents_ = contents.str();
+            data_ = contents_.data();
+            size_ = contents_.size();
+#else
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0) {
+                throw std::runtime_error("Cannot open " + path);
+            }
+            struct stat info;
+            if (fstat(fd, &info) != 0) {
+                ::close(fd);
+                throw std::runtime_error("Cannot stat " + path);
+            }
+            size_ = static_cast<size_t>(info.st_size);
+            if (size_ > 0) {
+                void *mapping = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (mapping == MAP_FAILED) {
+                    ::close(fd);
+                    throw std::runtime_error("Cannot map " + path);
+                }
+                madvise(mapping, size_, MADV_SEQUENTIAL);
+                data_ = static_cast<const char *>(mapping);
+            }
+            ::close(fd); // The mapping stays valid
+#endif
+        }
+
+        ~MappedFile() {
+#if !defined(_WIN32)
+            if (data_ != nullptr) {
+                munmap(const_cast<char *>(data_), size_);
+            }
+#endif
+        }
+
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+
+        const char *data() const {
+            return data_;
+        }
+
+        size_t size() const {
+            return size_;
+        }
+
+    private:
+        const char *data_ = nullptr;
+        size_t size_ = 0;
+#if defined(_WIN32)
+        std::string contents_;
+#endif
+    };
+
+    // A corpus file in both encodings. The file is UTF-8, or UTF-16 with a byte order mark.
+    // The encoding it is stored in is read in place from the mapping when it can be, and
+    // the other is transcoded once here. Throws std::runtime_error on malformed text, since
+    // the strict transcoders would throw in the middle of a benchmark.
+    class FileCorpus {
+    public:
+        explicit FileCorpus(const std::string &path) : file_(path) {
+            const auto *bytes = reinterpret_cast<const unsigned char *>(file_.data());
+            size_t size = file_.size();
+            bool utf16_le = size >= 2 && bytes[0] == 0xFF && bytes[1] == 0xFE;
+            bool utf16_be = size >= 2 && bytes[0] == 0xFE && bytes[1] == 0xFF;
+
+            if (utf16_le || utf16_be) {
+                if (size % 2 != 0) {
+                    throw std::runtime_error(path + ": odd length for UTF-16");
+                }
+                size_t units = (size - 2) / 2;
+                const auto *data = reinterpret_cast<const char16_t *>(file_.data() + 2);
+                if (utf16_le == hostIsLittleEndian()) {
+                    utf16_ = std::u16string_view(data, units);
+                } else {
+                    utf16_copy_.assign(data, units);
+                    fury::byteSwapArray(reinterpret_cast<uint16_t *>(&utf16_copy_[0]), units);
+                    utf16_ = utf16_copy_;
+                }
+                size_t error = validateUtf16(utf16_);
+                if (error != utf16_.size()) {
+                    throw std::runtime_error(path + ": unpaired surrogate at unit " + std::to_string(error));
+                }
+                utf8_copy_ = toUtf8(utf16_);
+                utf8_ = utf8_copy_;
+            } else {
+                size_t skip = size >= 3 && bytes[0] == 0xEF && bytes[1] == 0xBB && bytes[2] == 0xBF ? 3 : 0;
+                utf8_ = std::string_view(file_.data() + skip, size - skip);
+                size_t error = fury::validateUtf8(reinterpret_cast<const uint8_t *>(utf8_.data()), utf8_.size());
+                if (error != utf8_.size()) {
+                    throw std::runtime_error(path + ": malformed UTF-8 at byte " + std::to_string(error + skip));
+                }
+                utf16_copy_ = toUtf16(utf8_);
+                utf16_ = utf16_copy_;
+            }
+
+            std::u16string_view units = utf16_;
+            bool ascii = fury::isLatin(utf8_.data(), utf8_.size());
+            charset_ = ascii ? Charset::Ascii : fury::isLatin1(units.data(), units.size()) ? Charset::Latin1 : Charset::Unicode;
+        }
+
+        std::string_view utf8() const {
+            return utf8_;
+        }
+
+        std::u16string_view utf16() const {
+            return utf16_;
+        }
+
+        Charset charset() const {
+            return charset_;
+        }
+
+    private:
+        static bool hostIsLittleEndian() {
+            const uint16_t probe = 1;
+            return *reinterpret_cast<const uint8_t *>(&probe) == 1;
+        }
+
+        static size_t validateUtf16(std::u16string_view utf16) {
+            for (size_t i = 0; i < utf16.size(); ++i) {
+                if ((utf16[i] & 0xFC00) == 0xD800 && i + 1 < utf16.size() && (utf16[i + 1] & 0xFC00) == 0xDC00) {
+                    ++i;
+                } else if ((utf16[i] & 0xF800) == 0xD800) {
+                    return i;
+                }
+            }
+            return utf16.size();
+        }
+
+        MappedFile file_;
+        std::string utf8_copy_;
+        std::u16string utf16_copy_;
+        std::string_view utf8_;
+        std::u16string_view utf16_;
+        Charset charset_ = Charset::Unicode;
+    };
+
+} // namespace corpus
+
+#endif // POTIMIZER_CORPUS_H
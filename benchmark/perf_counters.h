@@ -0,0 +1,182 @@
+// Hardware performance counters through perf_event_open, to scope around a benchmark loop:
+// cycles, instructions, branch misses and L1D/LLC read misses, counted for the calling
+// thread in user space only, so perf_event_paranoid up to 2 allows them.
+//
+// Any counter the kernel refuses (no PMU in a VM, a stricter paranoid level, an event the
+// CPU lacks, or not Linux at all) reads as unavailable instead of failing, and callers
+// fall back to wall-clock and TSC numbers.
+#ifndef POTIMIZER_PERF_COUNTERS_H
+#define POTIMIZER_PERF_COUNTERS_H
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace perf {
+
+    enum Event { Cycles, Instructions, BranchMisses, L1Misses, LlcMisses, EventCount };
+
+    inline const char *eventName(Event event) {
+        static const char *const names[EventCount] = {"cycles", "instructions", "branch-misses", "L1-misses",
+                                                      "LLC-misses"};
+        return names[event];
+    }
+
+    // Counts between start() and stop(), scaled up if the kernel had to multiplex the group
+    struct Sample {
+        uint64_t values[EventCount] = {};
+        bool valid[EventCount] = {};
+
+        bool has(Event event) const {
+            return valid[event];
+        }
+
+        uint64_t operator[](Event event) const {
+            return values[event];
+        }
+    };
+
+    class Counters {
+    public:
+        Counters() {
+            for (int &fd : fds_) {
+                fd = -1;
+            }
+#if defined(__linux__)
+            for (int event = 0; event < EventCount; ++event) {
+                fds_[event] = openEvent(static_cast<Event>(event));
+                if (fds_[event] >= 0) {
+                    order_[opened_++] = event;
+                } else if (leader() < 0) {
+                    error_ = errno;
+                }
+            }
+#else
+            error_ = ENOSYS;
+#endif
+        }
+
+        ~Counters() {
+#if defined(__linux__)
+            for (int fd : fds_) {
+                if (fd >= 0) {
+                    close(fd);
+                }
+            }
+#endif
+        }
+
+        Counters(const Counters &) = delete;
+        Counters &operator=(const Counters &) = delete;
+
+        bool available() const {
+            return leader() >= 0;
+        }
+
+        // Why nothing could be counted, or the events that are missing
+        std::string status() const {
+            if (!available()) {
+                std::string reason = error_ == ENOENT ? "no hardware counters (virtual machine?)"
+                                     : error_ == EACCES || error_ == EPERM ? "not permitted, see /proc/sys/kernel/perf_event_paranoid"
+                                                                             : std::strerror(error_);
+                return "unavailable: " + reason;
+            }
+            std::string missing;
+            for (int event = 0; event < EventCount; ++event) {
+                if (fds_[event] < 0) {
+                    missing += std::string(missing.empty() ? "" : ", ") + eventName(static_cast<Event>(event));
+                }
+            }
+            return missing.empty() ? "available" : "available without " + missing;
+        }
+
+        void start() {
+#if defined(__linux__)
+            if (available()) {
+                ioctl(leader(), PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+                ioctl(leader(), PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+            }
+#endif
+        }
+
+        Sample stop() {
+            Sample sample;
+#if defined(__linux__)
+            if (!available()) {
+                return sample;
+            }
+            ioctl(leader(), PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+            // PERF_FORMAT_GROUP layout: count, time enabled, time running, then one value per
+            // event in the order they joined the group
+            uint64_t data[3 + EventCount];
+            ssize_t size = read(leader(), data, sizeof(data));
+            if (size < static_cast<ssize_t>(3 * sizeof(uint64_t)) || data[0] != static_cast<uint64_t>(opened_) || data[2] == 0) {
+                return sample;
+            }
+            double scale = static_cast<double>(data[1]) / static_cast<double>(data[2]);
+            for (int i = 0; i < opened_; ++i) {
+                sample.values[order_[i]] = static_cast<uint64_t>(static_cast<double>(data[3 + i]) * scale);
+                sample.valid[order_[i]] = true;
+            }
+#endif
+            return sample;
+        }
+
+    private:
+        int leader() const {
+            return opened_ > 0 ? fds_[order_[0]] : -1;
+        }
+
+#if defined(__linux__)
+        int openEvent(Event event) const {
+            perf_event_attr attr;
+            std::memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_HARDWARE;
+            switch (event) {
+            case Cycles:
+                attr.config = PERF_COUNT_HW_CPU_CYCLES;
+                break;
+            case Instructions:
+                attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+                break;
+            case BranchMisses:
+                attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+                break;
+            case L1Misses:
+                attr.type = PERF_TYPE_HW_CACHE;
+                attr.config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                              (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+                break;
+            default:
+                attr.type = PERF_TYPE_HW_CACHE;
+                attr.config = PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                              (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+                break;
+            }
+            attr.disabled = leader() < 0; // Members follow the leader's enable state
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+            return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, leader(), 0));
+        }
+#endif
+
+        int fds_[EventCount];
+        int order_[EventCount] = {};
+        int opened_ = 0;
+        int error_ = 0;
+    };
+
+} // namespace perf
+
+#endif // POTIMIZER_PERF_COUNTERS_H
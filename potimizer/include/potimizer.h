@@ -0,0 +1,69 @@
+/*
+ * C API for the potimizer string kernels. Every function picks the best kernel for the
+ * running CPU on first use, so one binary serves machines with and without AVX2.
+ *
+ * UTF-16 data is passed as uint16_t code units. Functions taking little_endian read the
+ * units in that byte order; the others read them in host order.
+ */
+#ifndef POTIMIZER_H
+#define POTIMIZER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+#if defined(POTIMIZER_BUILD)
+#define POTIMIZER_API __declspec(dllexport)
+#else
+#define POTIMIZER_API __declspec(dllimport)
+#endif
+#else
+#define POTIMIZER_API __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Returned by the size_t functions when the input is malformed */
+#define POTIMIZER_ERROR ((size_t)-1)
+
+#define POTIMIZER_VERSION "0.1.0"
+
+POTIMIZER_API const char *potimizer_version(void);
+
+/* 1 when the AVX2 kernels are in use (x86-64 CPUs with AVX2); always 0 on ARM */
+POTIMIZER_API int potimizer_has_avx2(void);
+
+/* Classification: 1 or 0 */
+POTIMIZER_API int potimizer_is_ascii(const char *data, size_t len);
+POTIMIZER_API int potimizer_is_latin1(const uint16_t *data, size_t len);
+
+/* Counters */
+POTIMIZER_API size_t potimizer_count_code_points_utf8(const char *data, size_t len);
+POTIMIZER_API size_t potimizer_count_code_points_utf16(const uint16_t *data, size_t len);
+/* UTF-8 bytes needed for valid UTF-16 input */
+POTIMIZER_API size_t potimizer_utf8_length_from_utf16(const uint16_t *data, size_t len, int little_endian);
+
+/* Validators: len when valid, else the offset of the first malformed unit or sequence */
+POTIMIZER_API size_t potimizer_validate_utf8(const char *data, size_t len);
+POTIMIZER_API size_t potimizer_validate_utf16(const uint16_t *data, size_t len, int little_endian);
+
+/*
+ * Transcoders return the number of units written, or POTIMIZER_ERROR for malformed input
+ * (dst is then unspecified).
+ *   utf16_to_utf8:    dst needs 3 * len bytes
+ *   utf8_to_utf16:    dst needs len units, written in host order
+ *   latin1_compress:  dst needs len bytes; fails if a unit is above 0xFF
+ *   latin1_inflate:   dst needs len units
+ */
+POTIMIZER_API size_t potimizer_utf16_to_utf8(const uint16_t *src, size_t len, int little_endian, char *dst);
+POTIMIZER_API size_t potimizer_utf8_to_utf16(const char *src, size_t len, uint16_t *dst);
+POTIMIZER_API size_t potimizer_latin1_compress(const uint16_t *src, size_t len, char *dst);
+POTIMIZER_API size_t potimizer_latin1_inflate(const char *src, size_t len, uint16_t *dst);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* POTIMIZER_H */
@@ -0,0 +1,194 @@
+// C API over SIMD/fury.h and string_utf16_to_utf8/utf16_to_utf8.h
+#include "potimizer.h"
+
+#include <algorithm>
+#include <exception>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "fury.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+// The transcoder assumes AVX2 everywhere. Only its own functions are compiled for AVX2, and
+// they are called after the CPU check, so the library still loads and runs without AVX2.
+// The standard headers above are included first to keep them out of the region.
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx2,bmi,popcnt"))), apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx2,bmi,popcnt")
+#endif
+#include "utf16_to_utf8.h"
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+#define POTIMIZER_HAS_TRANSCODER 1
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+// NEON is part of the AArch64 baseline, so the transcoder needs no runtime check there
+#include "utf16_to_utf8.h"
+#define POTIMIZER_HAS_TRANSCODER 1
+#endif
+
+namespace {
+
+    bool useTranscoder() {
+#if defined(POTIMIZER_HAS_TRANSCODER) && (defined(__x86_64__) || defined(_M_X64))
+        static const bool avx2 = fury::cpuSupportsAVX2();
+        return avx2;
+#elif defined(POTIMIZER_HAS_TRANSCODER)
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    inline uint16_t loadUnit(const uint16_t *data, size_t i, bool little_endian) {
+        return little_endian ? data[i] : fury::byteSwap16(data[i]);
+    }
+
+    inline const char16_t *asUtf16(const uint16_t *data) {
+        return reinterpret_cast<const char16_t *>(data);
+    }
+
+    size_t validateUtf16Scalar(const uint16_t *data, size_t len, bool little_endian) {
+        for (size_t i = 0; i < len; ++i) {
+            uint16_t unit = loadUnit(data, i, little_endian);
+            if ((unit & 0xFC00) == 0xD800) {
+                // A high surrogate without its low one is reported at the high surrogate
+                if (i + 1 == len || (loadUnit(data, i + 1, little_endian) & 0xFC00) != 0xDC00) {
+                    return i;
+                }
+                ++i;
+            } else if ((unit & 0xFC00) == 0xDC00) {
+                return i;
+            }
+        }
+        return len;
+    }
+
+    size_t utf8LengthScalar(const uint16_t *data, size_t len, bool little_endian) {
+        size_t length = len;
+        for (size_t i = 0; i < len; ++i) {
+            uint16_t unit = loadUnit(data, i, little_endian);
+            length += unit >= 0x80;
+            length += unit >= 0x800 && (unit & 0xF800) != 0xD800;
+        }
+        return length;
+    }
+
+    // Valid input only. Big-endian input is swapped in chunks that never split a pair.
+    size_t utf16ToUtf8Fallback(const uint16_t *src, size_t len, bool little_endian, char *dst) {
+        uint8_t *out = reinterpret_cast<uint8_t *>(dst);
+        if (little_endian) {
+            return fury::utf16ToUtf8(asUtf16(src), len, out);
+        }
+        char16_t chunk[1024];
+        size_t written = 0;
+        size_t i = 0;
+        while (i < len) {
+            size_t n = std::min(len - i, sizeof(chunk) / sizeof(chunk[0]));
+            fury::byteSwapArray16(src + i, chunk, n);
+            if (i + n < len && (chunk[n - 1] & 0xFC00) == 0xD800) {
+                --n;
+            }
+            written += fury::utf16ToUtf8(chunk, n, out + written);
+            i += n;
+        }
+        return written;
+    }
+
+} // namespace
+
+extern "C" {
+
+const char *potimizer_version(void) {
+    return POTIMIZER_VERSION;
+}
+
+int potimizer_has_avx2(void) {
+#if defined(__x86_64__) || defined(_M_X64)
+    return fury::cpuSupportsAVX2() ? 1 : 0;
+#else
+    return 0; // NEON and the other targets never run the AVX2 kernels
+#endif
+}
+
+int potimizer_is_ascii(const char *data, size_t len) {
+    return fury::isLatin(data, len) ? 1 : 0;
+}
+
+int potimizer_is_latin1(const uint16_t *data, size_t len) {
+    return fury::isLatin1(asUtf16(data), len) ? 1 : 0;
+}
+
+size_t potimizer_count_code_points_utf8(const char *data, size_t len) {
+    return fury::count_code_points_utf8(data, len);
+}
+
+size_t potimizer_count_code_points_utf16(const uint16_t *data, size_t len) {
+    return fury::count_code_points_utf16(asUtf16(data), len);
+}
+
+size_t potimizer_utf8_length_from_utf16(const uint16_t *data, size_t len, int little_endian) {
+#if defined(POTIMIZER_HAS_TRANSCODER)
+    if (useTranscoder()) {
+        return utf8_length_simd(asUtf16(data), len, little_endian != 0);
+    }
+#endif
+    return utf8LengthScalar(data, len, little_endian != 0);
+}
+
+size_t potimizer_validate_utf8(const char *data, size_t len) {
+    return fury::validateUtf8(reinterpret_cast<const uint8_t *>(data), len);
+}
+
+size_t potimizer_validate_utf16(const uint16_t *data, size_t len, int little_endian) {
+#if defined(POTIMIZER_HAS_TRANSCODER)
+    if (useTranscoder()) {
+        return validate_utf16_simd(asUtf16(data), len, little_endian != 0);
+    }
+#endif
+    return validateUtf16Scalar(data, len, little_endian != 0);
+}
+
+size_t potimizer_utf16_to_utf8(const uint16_t *src, size_t len, int little_endian, char *dst) {
+#if defined(POTIMIZER_HAS_TRANSCODER)
+    if (useTranscoder()) {
+        try {
+            return utf16_to_utf8_simd(asUtf16(src), len, little_endian != 0, dst) - dst;
+        } catch (const std::runtime_error &) {
+            return POTIMIZER_ERROR;
+        }
+    }
+#endif
+    if (validateUtf16Scalar(src, len, little_endian != 0) != len) {
+        return POTIMIZER_ERROR;
+    }
+    return utf16ToUtf8Fallback(src, len, little_endian != 0, dst);
+}
+
+size_t potimizer_utf8_to_utf16(const char *src, size_t len, uint16_t *dst) {
+    try {
+        return fury::utf8ToUtf16(reinterpret_cast<const uint8_t *>(src), len, reinterpret_cast<char16_t *>(dst));
+    } catch (const std::runtime_error &) {
+        return POTIMIZER_ERROR;
+    }
+}
+
+size_t potimizer_latin1_compress(const uint16_t *src, size_t len, char *dst) {
+    if (!fury::isLatin1(asUtf16(src), len)) {
+        return POTIMIZER_ERROR;
+    }
+    return fury::compressLatin1(asUtf16(src), len, reinterpret_cast<uint8_t *>(dst));
+}
+
+size_t potimizer_latin1_inflate(const char *src, size_t len, uint16_t *dst) {
+    return fury::inflateLatin1(reinterpret_cast<const uint8_t *>(src), len, reinterpret_cast<char16_t *>(dst));
+}
+
+} // extern "C"
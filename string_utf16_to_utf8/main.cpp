@@ -1,161 +1,10 @@
+#include "utf16_to_utf8.h"
 #include <iostream>
-#include <vector>
-#include <string>
 #include <random>
 #include <chrono>
-#include <stdexcept>
-#include <algorithm>
-#include <immintrin.h>
 #include <locale>
 #include <codecvt>
 
-// Convert UTF-16 encoded string to UTF-8 encoded string without using AVX2
-std::string utf16_to_utf8(const std::u16string &utf16, bool is_little_endian) {
-    std::string utf8;
-
-    for (size_t i = 0; i < utf16.size(); ++i) {
-        uint16_t w1 = utf16[i];
-        if (!is_little_endian) {
-            w1 = (w1 >> 8) | (w1 << 8); // Swap bytes for big endian
-        }
-
-        if (w1 >= 0xD800 && w1 <= 0xDBFF) {
-            if (i + 1 >= utf16.size()) {
-                throw std::runtime_error("Invalid UTF-16 sequence");
-            }
-
-            uint16_t w2 = utf16[++i];
-            if (!is_little_endian) {
-                w2 = (w2 >> 8) | (w2 << 8); // Swap bytes for big endian
-            }
-
-            if (w2 < 0xDC00 || w2 > 0xDFFF) {
-                throw std::runtime_error("Invalid UTF-16 sequence");
-            }
-
-            uint32_t code_point = ((w1 - 0xD800) << 10) + (w2 - 0xDC00) + 0x10000;
-
-            utf8.push_back(0xF0 | (code_point >> 18));
-            utf8.push_back(0x80 | ((code_point >> 12) & 0x3F));
-            utf8.push_back(0x80 | ((code_point >> 6) & 0x3F));
-            utf8.push_back(0x80 | (code_point & 0x3F));
-        } else if (w1 >= 0xDC00 && w1 <= 0xDFFF) {
-            throw std::runtime_error("Invalid UTF-16 sequence");
-        } else {
-            if (w1 < 0x80) {
-                utf8.push_back(static_cast<char>(w1));
-            } else if (w1 < 0x800) {
-                utf8.push_back(0xC0 | (w1 >> 6));
-                utf8.push_back(0x80 | (w1 & 0x3F));
-            } else {
-                utf8.push_back(0xE0 | (w1 >> 12));
-                utf8.push_back(0x80 | ((w1 >> 6) & 0x3F));
-                utf8.push_back(0x80 | (w1 & 0x3F));
-            }
-        }
-    }
-
-    return utf8;
-}
-
-// Convert a single UTF-16 code unit to UTF-8 bytes
-// This function assumes valid UTF-16 input.
-inline void utf16_to_utf8(uint16_t utf16, char *&utf8) {
-    if (utf16 < 0x80) {
-        *utf8++ = static_cast<char>(utf16);
-    } else if (utf16 < 0x800) {
-        *utf8++ = static_cast<char>((utf16 >> 6) | 0xC0);
-        *utf8++ = static_cast<char>((utf16 & 0x3F) | 0x80);
-    } else {
-        *utf8++ = static_cast<char>((utf16 >> 12) | 0xE0);
-        *utf8++ = static_cast<char>(((utf16 >> 6) & 0x3F) | 0x80);
-        *utf8++ = static_cast<char>((utf16 & 0x3F) | 0x80);
-    }
-}
-
-// Swap bytes to convert from big endian to little endian
-inline uint16_t swap_bytes(uint16_t value) {
-    return (value >> 8) | (value << 8);
-}
-
-std::string utf16_to_utf8_avx2(const std::u16string &utf16, bool is_little_endian) {
-    std::string utf8;
-    utf8.reserve(utf16.size() * 3); // Reserve enough space to avoid frequent reallocations
-
-    const __m256i one = _mm256_set1_epi16(1);
-    const __m256i limit1 = _mm256_set1_epi16(0x80);
-    const __m256i limit2 = _mm256_set1_epi16(0x800);
-
-    char buffer[48]; // Buffer to hold temporary UTF-8 bytes
-    char *output = buffer;
-
-    size_t i = 0;
-    size_t n = utf16.size();
-
-    if (is_little_endian) {
-        while (i + 16 <= n) {
-            __m256i in = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(utf16.data() + i));
-            __m256i mask1 = _mm256_cmpgt_epi16(in, limit1);
-            __m256i mask2 = _mm256_cmpgt_epi16(in, limit2);
-
-            if (_mm256_testz_si256(mask1, mask1)) {
-                for (int j = 0; j < 16; ++j) {
-                    *output++ = static_cast<char>(utf16[i + j]);
-                }
-            } else if (_mm256_testz_si256(mask2, mask2)) {
-                for (int j = 0; j < 16; ++j) {
-                    utf16_to_utf8(utf16[i + j], output);
-                }
-            } else {
-                for (int j = 0; j < 16; ++j) {
-                    utf16_to_utf8(utf16[i + j], output);
-                }
-            }
-
-            utf8.append(buffer, output - buffer);
-            output = buffer; // Reset output buffer pointer
-            i += 16;
-        }
-    } else {
-        while (i + 16 <= n) {
-            __m256i in = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(utf16.data() + i));
-            in = _mm256_or_si256(_mm256_srli_epi16(in, 8), _mm256_slli_epi16(in, 8)); // Swap bytes for big endian
-
-            __m256i mask1 = _mm256_cmpgt_epi16(in, limit1);
-            __m256i mask2 = _mm256_cmpgt_epi16(in, limit2);
-
-            if (_mm256_testz_si256(mask1, mask1)) {
-                for (int j = 0; j < 16; ++j) {
-                    *output++ = static_cast<char>(swap_bytes(utf16[i + j]));
-                }
-            } else if (_mm256_testz_si256(mask2, mask2)) {
-                for (int j = 0; j < 16; ++j) {
-                    utf16_to_utf8(swap_bytes(utf16[i + j]), output);
-                }
-            } else {
-                for (int j = 0; j < 16; ++j) {
-                    utf16_to_utf8(swap_bytes(utf16[i + j]), output);
-                }
-            }
-
-            utf8.append(buffer, output - buffer);
-            output = buffer; // Reset output buffer pointer
-            i += 16;
-        }
-    }
-
-    while (i < n) {
-        uint16_t code_unit = utf16[i++];
-        if (!is_little_endian) {
-            code_unit = swap_bytes(code_unit);
-        }
-        utf16_to_utf8(code_unit, output);
-    }
-    utf8.append(buffer, output - buffer);
-
-    return utf8;
-}
-
 // Generate random UTF-16 string ensuring valid surrogate pairs
 std::u16string generate_random_utf16_string(size_t length) {
     std::u16string str;
@@ -214,6 +63,7 @@ int main() {
         std::cerr << "Caught exception: " << e.what() << std::endl;
     }
 
+#if defined(__x86_64__) || defined(_M_X64)
     // Test conversion with AVX2
     try {
         auto start = std::chrono::high_resolution_clock::now();
@@ -226,6 +76,218 @@ int main() {
     } catch (const std::exception &e) {
         std::cerr << "Caught exception: " << e.what() << std::endl;
     }
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+    // Test conversion with NEON against the scalar converter
+    try {
+        auto start = std::chrono::high_resolution_clock::now();
+        size_t mismatches = 0;
+        for (const auto &str : test_strings) {
+            std::string utf8(str.size() * 3, '\0');
+            utf8.resize(utf16_to_utf8_neon(str.data(), str.size(), true, &utf8[0]) - utf8.data());
+            mismatches += utf8 != utf16_to_utf8(str, true);
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double> elapsed = end - start;
+        std::cout << "Conversion with NEON (checked against scalar) took: " << elapsed.count() << " seconds"
+                  << (mismatches == 0 ? "" : " (MISMATCH)") << std::endl;
+
+        start = std::chrono::high_resolution_clock::now();
+        size_t valid = 0;
+        size_t length = 0;
+        for (const auto &str : test_strings) {
+            valid += validate_utf16_neon(str.data(), str.size(), true) == str.size();
+            length += utf8_length_neon(str.data(), str.size(), true);
+        }
+        end = std::chrono::high_resolution_clock::now();
+        elapsed = end - start;
+        std::cout << "UTF-16 validation and UTF-8 length with NEON took: " << elapsed.count() << " seconds ("
+                  << valid << "/" << test_strings.size() << " valid, " << length << " bytes)" << std::endl;
+    } catch (const std::exception &e) {
+        std::cerr << "Caught exception: " << e.what() << std::endl;
+    }
+#endif
+
+    // Test parallel conversion on one large document
+    try {
+        std::u16string document;
+        for (const auto &str : test_strings) {
+            document += str;
+        }
+
+        auto start = std::chrono::high_resolution_clock::now();
+        std::string utf8 = utf16_to_utf8_simd(document, true);
+        auto end = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double> elapsed = end - start;
+        std::cout << "Single-threaded document conversion took: " << elapsed.count() << " seconds" << std::endl;
+
+        start = std::chrono::high_resolution_clock::now();
+        std::string utf8_parallel = utf16_to_utf8_parallel(document, true);
+        end = std::chrono::high_resolution_clock::now();
+        elapsed = end - start;
+        std::cout << "Parallel document conversion with " << std::thread::hardware_concurrency()
+                  << " threads took: " << elapsed.count() << " seconds"
+                  << (utf8 == utf8_parallel ? "" : " (MISMATCH)") << std::endl;
+    } catch (const std::exception &e) {
+        std::cerr << "Caught exception: " << e.what() << std::endl;
+    }
+
+    // Test batch conversion of many short strings into one arena
+    try {
+        std::u16string column;
+        std::vector<size_t> lengths;
+        std::mt19937 generator(42);
+        for (size_t i = 0; i < 100000; ++i) {
+            size_t length = 4 + generator() % 24;
+            size_t pos = column.size();
+            column += i % 10 == 0 ? generate_random_utf16_string(length) : std::u16string(length, u'a' + i % 26);
+            lengths.push_back(column.size() - pos);
+        }
+        std::vector<std::u16string_view> views;
+        for (size_t i = 0, pos = 0; i < lengths.size(); pos += lengths[i++]) {
+            views.emplace_back(column.data() + pos, lengths[i]);
+        }
+
+        auto start = std::chrono::high_resolution_clock::now();
+        for (const auto &view : views) {
+            std::string utf8 = utf16_to_utf8_simd(std::u16string(view), true);
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double> elapsed = end - start;
+        std::cout << "Per-string conversion of " << views.size() << " short strings took: " << elapsed.count() << " seconds" << std::endl;
+
+        std::string arena;
+        std::vector<size_t> offsets;
+        start = std::chrono::high_resolution_clock::now();
+        utf16_to_utf8_batch(views.data(), views.size(), true, arena, offsets);
+        end = std::chrono::high_resolution_clock::now();
+        elapsed = end - start;
+        std::cout << "Batch conversion of " << views.size() << " short strings took: " << elapsed.count() << " seconds" << std::endl;
+    } catch (const std::exception &e) {
+        std::cerr << "Caught exception: " << e.what() << std::endl;
+    }
+
+    // Test Java strings with unpaired surrogates and NUL in the lenient modes
+    try {
+        std::vector<std::u16string> java_strings = test_strings;
+        std::mt19937 generator(7);
+        for (auto &str : java_strings) {
+            str[generator() % str.size()] = static_cast<char16_t>(0xD800 + generator() % 0x800);
+            str[generator() % str.size()] = 0;
+        }
+
+        auto start = std::chrono::high_resolution_clock::now();
+        for (const auto &str : java_strings) {
+            std::string wtf8 = utf16_to_utf8_simd(str, true, Utf8Mode::Wtf8);
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double> elapsed = end - start;
+        std::cout << "WTF-8 conversion took: " << elapsed.count() << " seconds" << std::endl;
+
+        start = std::chrono::high_resolution_clock::now();
+        for (const auto &str : java_strings) {
+            std::string modified_utf8 = utf16_to_utf8_simd(str, true, Utf8Mode::ModifiedUtf8);
+        }
+        end = std::chrono::high_resolution_clock::now();
+        elapsed = end - start;
+        std::cout << "Modified UTF-8 conversion took: " << elapsed.count() << " seconds" << std::endl;
+    } catch (const std::exception &e) {
+        std::cerr << "Caught exception: " << e.what() << std::endl;
+    }
+
+#if defined(__x86_64__) || defined(_M_X64)
+    // Test UTF-32 conversions against the standard library
+    try {
+        std::vector<std::u32string> code_points;
+        auto start = std::chrono::high_resolution_clock::now();
+        for (const auto &str : test_strings) {
+            code_points.push_back(utf16_to_utf32_avx2(str, true));
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double> elapsed = end - start;
+        std::cout << "UTF-16 to UTF-32 with AVX2 took: " << elapsed.count() << " seconds" << std::endl;
+
+        start = std::chrono::high_resolution_clock::now();
+        for (const auto &str : code_points) {
+            std::u16string utf16 = utf32_to_utf16_avx2(str, true);
+        }
+        end = std::chrono::high_resolution_clock::now();
+        elapsed = end - start;
+        std::cout << "UTF-32 to UTF-16 with AVX2 took: " << elapsed.count() << " seconds" << std::endl;
+
+        start = std::chrono::high_resolution_clock::now();
+        for (const auto &str : code_points) {
+            std::wstring_convert<std::codecvt_utf8<char32_t>, char32_t> convert;
+            std::string utf8 = convert.to_bytes(str);
+        }
+        end = std::chrono::high_resolution_clock::now();
+        elapsed = end - start;
+        std::cout << "Standard library UTF-32 to UTF-8 took: " << elapsed.count() << " seconds" << std::endl;
+
+        start = std::chrono::high_resolution_clock::now();
+        for (const auto &str : code_points) {
+            std::string utf8 = utf32_to_utf8_avx2(str);
+        }
+        end = std::chrono::high_resolution_clock::now();
+        elapsed = end - start;
+        std::cout << "UTF-32 to UTF-8 with AVX2 took: " << elapsed.count() << " seconds" << std::endl;
+    } catch (const std::exception &e) {
+        std::cerr << "Caught exception: " << e.what() << std::endl;
+    }
+
+    // Test validation without transcoding
+    try {
+        auto start = std::chrono::high_resolution_clock::now();
+        size_t valid = 0;
+        for (const auto &str : test_strings) {
+            valid += is_valid_utf16_avx2(str, true);
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double> elapsed = end - start;
+        std::cout << "UTF-16 validation with AVX2 took: " << elapsed.count() << " seconds ("
+                  << valid << "/" << test_strings.size() << " valid)" << std::endl;
+    } catch (const std::exception &e) {
+        std::cerr << "Caught exception: " << e.what() << std::endl;
+    }
+
+    // Test conversion capped at a byte budget
+    try {
+        auto start = std::chrono::high_resolution_clock::now();
+        for (const auto &str : test_strings) {
+            std::string utf8 = utf16_to_utf8_truncated_avx2(str, true, 256);
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double> elapsed = end - start;
+        std::cout << "Conversion truncated to 256 bytes with AVX2 took: " << elapsed.count() << " seconds" << std::endl;
+    } catch (const std::exception &e) {
+        std::cerr << "Caught exception: " << e.what() << std::endl;
+    }
+
+    // Test JSON escaping fused into the conversion
+    try {
+        std::vector<std::u16string> json_strings = test_strings;
+        std::mt19937 generator(11);
+        for (auto &str : json_strings) {
+            for (char16_t special : {u'"', u'\n'}) {
+                char16_t &c = str[generator() % str.size()];
+                if (c < 0xD800 || c > 0xDFFF) { // Keep the surrogate pairs intact
+                    c = special;
+                }
+            }
+        }
+
+        auto start = std::chrono::high_resolution_clock::now();
+        for (const auto &str : json_strings) {
+            std::string json = utf16_to_utf8_json_avx2(str, true);
+        }
+        auto end = std::chrono::high_resolution_clock::now();
+        std::chrono::duration<double> elapsed = end - start;
+        std::cout << "Conversion with JSON escaping with AVX2 took: " << elapsed.count() << " seconds" << std::endl;
+    } catch (const std::exception &e) {
+        std::cerr << "Caught exception: " << e.what() << std::endl;
+    }
+#endif
 
     return 0;
 }
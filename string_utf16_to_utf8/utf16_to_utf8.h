@@ -0,0 +1,1030 @@
+// UTF-16 to UTF-8 transcoding with AVX2, plus UTF-32, WTF-8, JSON escaping, validation and
+// parallel/batch variants. The _avx2 kernels assume AVX2; on ARM the core ones have _neon
+// versions, and the _simd functions pick whichever the build targets. main.cpp benchmarks them.
+#ifndef POTIMIZER_UTF16_TO_UTF8_H
+#define POTIMIZER_UTF16_TO_UTF8_H
+
+#include <vector>
+#include <string>
+#include <string_view>
+#include <stdexcept>
+#include <algorithm>
+#include <thread>
+#include <exception>
+#include <cstdint>
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+// Convert UTF-16 encoded string to UTF-8 encoded string without using AVX2
+inline std::string utf16_to_utf8(const std::u16string &utf16, bool is_little_endian) {
+    std::string utf8;
+
+    for (size_t i = 0; i < utf16.size(); ++i) {
+        uint16_t w1 = utf16[i];
+        if (!is_little_endian) {
+            w1 = (w1 >> 8) | (w1 << 8); // Swap bytes for big endian
+        }
+
+        if (w1 >= 0xD800 && w1 <= 0xDBFF) {
+            if (i + 1 >= utf16.size()) {
+                throw std::runtime_error("Invalid UTF-16 sequence");
+            }
+
+            uint16_t w2 = utf16[++i];
+            if (!is_little_endian) {
+                w2 = (w2 >> 8) | (w2 << 8); // Swap bytes for big endian
+            }
+
+            if (w2 < 0xDC00 || w2 > 0xDFFF) {
+                throw std::runtime_error("Invalid UTF-16 sequence");
+            }
+
+            uint32_t code_point = ((w1 - 0xD800) << 10) + (w2 - 0xDC00) + 0x10000;
+
+            utf8.push_back(0xF0 | (code_point >> 18));
+            utf8.push_back(0x80 | ((code_point >> 12) & 0x3F));
+            utf8.push_back(0x80 | ((code_point >> 6) & 0x3F));
+            utf8.push_back(0x80 | (code_point & 0x3F));
+        } else if (w1 >= 0xDC00 && w1 <= 0xDFFF) {
+            throw std::runtime_error("Invalid UTF-16 sequence");
+        } else {
+            if (w1 < 0x80) {
+                utf8.push_back(static_cast<char>(w1));
+            } else if (w1 < 0x800) {
+                utf8.push_back(0xC0 | (w1 >> 6));
+                utf8.push_back(0x80 | (w1 & 0x3F));
+            } else {
+                utf8.push_back(0xE0 | (w1 >> 12));
+                utf8.push_back(0x80 | ((w1 >> 6) & 0x3F));
+                utf8.push_back(0x80 | (w1 & 0x3F));
+            }
+        }
+    }
+
+    return utf8;
+}
+
+// Convert a single UTF-16 code unit to UTF-8 bytes
+// This function assumes valid UTF-16 input.
+inline void utf16_to_utf8(uint16_t utf16, char *&utf8) {
+    if (utf16 < 0x80) {
+        *utf8++ = static_cast<char>(utf16);
+    } else if (utf16 < 0x800) {
+        *utf8++ = static_cast<char>((utf16 >> 6) | 0xC0);
+        *utf8++ = static_cast<char>((utf16 & 0x3F) | 0x80);
+    } else {
+        *utf8++ = static_cast<char>((utf16 >> 12) | 0xE0);
+        *utf8++ = static_cast<char>(((utf16 >> 6) & 0x3F) | 0x80);
+        *utf8++ = static_cast<char>((utf16 & 0x3F) | 0x80);
+    }
+}
+
+// Swap bytes to convert from big endian to little endian
+inline uint16_t swap_bytes(uint16_t value) {
+    return (value >> 8) | (value << 8);
+}
+
+// How unpaired surrogates and other Java-specific cases are written out
+enum class Utf8Mode {
+    // Standard UTF-8, unpaired surrogates throw
+    Strict,
+    // WTF-8: unpaired surrogates are encoded as 3 bytes, valid pairs as 4
+    Wtf8,
+    // JNI modified UTF-8: NUL becomes 0xC0 0x80 and every surrogate, paired or not,
+    // is encoded on its own as 3 bytes
+    ModifiedUtf8,
+};
+
+// Convert the code unit at utf16[i] (and its trailing low surrogate, if any) to UTF-8 and
+// return the index of the next unconsumed code unit.
+inline size_t utf16_to_utf8(const char16_t *utf16, size_t n, size_t i, bool is_little_endian, char *&utf8,
+                            Utf8Mode mode = Utf8Mode::Strict) {
+    uint16_t w1 = is_little_endian ? utf16[i] : swap_bytes(utf16[i]);
+    if (w1 < 0xD800 || w1 > 0xDFFF) {
+        if (w1 == 0 && mode == Utf8Mode::ModifiedUtf8) {
+            *utf8++ = static_cast<char>(0xC0);
+            *utf8++ = static_cast<char>(0x80);
+        } else {
+            utf16_to_utf8(w1, utf8);
+        }
+        return i + 1;
+    }
+    if (mode == Utf8Mode::ModifiedUtf8) {
+        utf16_to_utf8(w1, utf8);
+        return i + 1;
+    }
+
+    uint16_t w2 = 0;
+    if (w1 <= 0xDBFF && i + 1 < n) {
+        w2 = is_little_endian ? utf16[i + 1] : swap_bytes(utf16[i + 1]);
+    }
+    if (w2 < 0xDC00 || w2 > 0xDFFF) {
+        if (mode != Utf8Mode::Wtf8) {
+            throw std::runtime_error("Invalid UTF-16 sequence");
+        }
+        utf16_to_utf8(w1, utf8);
+        return i + 1;
+    }
+
+    uint32_t code_point = ((w1 - 0xD800) << 10) + (w2 - 0xDC00) + 0x10000;
+    *utf8++ = static_cast<char>(0xF0 | (code_point >> 18));
+    *utf8++ = static_cast<char>(0x80 | ((code_point >> 12) & 0x3F));
+    *utf8++ = static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+    *utf8++ = static_cast<char>(0x80 | (code_point & 0x3F));
+    return i + 2;
+}
+
+// Decode the code point at utf16[i], combining a surrogate pair, and return the index of the
+// next unconsumed code unit.
+inline size_t utf16_to_utf32(const char16_t *utf16, size_t n, size_t i, bool is_little_endian, char32_t *&utf32) {
+    uint16_t w1 = is_little_endian ? utf16[i] : swap_bytes(utf16[i]);
+    if (w1 < 0xD800 || w1 > 0xDFFF) {
+        *utf32++ = w1;
+        return i + 1;
+    }
+    if (w1 > 0xDBFF || i + 1 >= n) {
+        throw std::runtime_error("Invalid UTF-16 sequence");
+    }
+
+    uint16_t w2 = is_little_endian ? utf16[i + 1] : swap_bytes(utf16[i + 1]);
+    if (w2 < 0xDC00 || w2 > 0xDFFF) {
+        throw std::runtime_error("Invalid UTF-16 sequence");
+    }
+
+    *utf32++ = ((w1 - 0xD800) << 10) + (w2 - 0xDC00) + 0x10000;
+    return i + 2;
+}
+
+inline void check_code_point(uint32_t code_point) {
+    if (code_point > 0x10FFFF || (code_point >= 0xD800 && code_point <= 0xDFFF)) {
+        throw std::runtime_error("Invalid UTF-32 code point");
+    }
+}
+
+// Encode one code point as UTF-16, splitting it into a surrogate pair above 0xFFFF
+inline void utf32_to_utf16(uint32_t code_point, bool is_little_endian, char16_t *&utf16) {
+    check_code_point(code_point);
+    if (code_point < 0x10000) {
+        uint16_t w = static_cast<uint16_t>(code_point);
+        *utf16++ = is_little_endian ? w : swap_bytes(w);
+        return;
+    }
+
+    code_point -= 0x10000;
+    uint16_t w1 = static_cast<uint16_t>((code_point >> 10) + 0xD800);
+    uint16_t w2 = static_cast<uint16_t>((code_point & 0x3FF) + 0xDC00);
+    *utf16++ = is_little_endian ? w1 : swap_bytes(w1);
+    *utf16++ = is_little_endian ? w2 : swap_bytes(w2);
+}
+
+// Encode one code point as UTF-8
+inline void utf32_to_utf8(uint32_t code_point, char *&utf8) {
+    check_code_point(code_point);
+    if (code_point < 0x10000) {
+        utf16_to_utf8(static_cast<uint16_t>(code_point), utf8);
+        return;
+    }
+
+    *utf8++ = static_cast<char>(0xF0 | (code_point >> 18));
+    *utf8++ = static_cast<char>(0x80 | ((code_point >> 12) & 0x3F));
+    *utf8++ = static_cast<char>(0x80 | ((code_point >> 6) & 0x3F));
+    *utf8++ = static_cast<char>(0x80 | (code_point & 0x3F));
+}
+
+inline int count_trailing_zeros(uint32_t value) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, value);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctz(value);
+#endif
+}
+
+inline int count_trailing_zeros64(uint64_t value) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward64(&index, value);
+    return static_cast<int>(index);
+#else
+    return __builtin_ctzll(value);
+#endif
+}
+
+#if defined(__x86_64__) || defined(_M_X64)
+inline __m256i load_utf16_avx2(const char16_t *data, bool is_little_endian) {
+    __m256i in = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data));
+    if (!is_little_endian) {
+        in = _mm256_or_si256(_mm256_srli_epi16(in, 8), _mm256_slli_epi16(in, 8)); // Swap bytes for big endian
+    }
+    return in;
+}
+
+// Convert n UTF-16 code units to UTF-8, writing to utf8 and returning the end of the output.
+// The destination must have room for n * 3 bytes.
+inline char *utf16_to_utf8_avx2(const char16_t *utf16, size_t n, bool is_little_endian, char *utf8,
+                         Utf8Mode mode = Utf8Mode::Strict) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i ascii_mask = _mm256_set1_epi16(static_cast<short>(0xFF80));
+    const __m256i surrogate_mask = _mm256_set1_epi16(static_cast<short>(0xF800));
+    const __m256i surrogate = _mm256_set1_epi16(static_cast<short>(0xD800));
+
+    size_t i = 0;
+    while (i + 16 <= n) {
+        __m256i in = load_utf16_avx2(utf16 + i, is_little_endian);
+
+        // Modified UTF-8 writes NUL as two bytes, so it cannot take the narrowing path
+        bool has_nul = mode == Utf8Mode::ModifiedUtf8 && _mm256_movemask_epi8(_mm256_cmpeq_epi16(in, zero)) != 0;
+
+        if (_mm256_testz_si256(in, ascii_mask) && !has_nul) {
+            // All 16 code units are ASCII, narrow them to bytes in one store
+            __m128i packed = _mm_packus_epi16(_mm256_castsi256_si128(in), _mm256_extracti128_si256(in, 1));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(utf8), packed);
+            utf8 += 16;
+            i += 16;
+            continue;
+        }
+
+        __m256i surrogates = _mm256_cmpeq_epi16(_mm256_and_si256(in, surrogate_mask), surrogate);
+        if (_mm256_testz_si256(surrogates, surrogates) && !has_nul) {
+            // No surrogates, every mode encodes each code unit on its own
+            for (int j = 0; j < 16; ++j) {
+                uint16_t code_unit = is_little_endian ? utf16[i + j] : swap_bytes(utf16[i + j]);
+                utf16_to_utf8(code_unit, utf8);
+            }
+            i += 16;
+            continue;
+        }
+
+        // A surrogate pair may straddle the block end, so the scalar loop can overshoot by one
+        size_t block_end = i + 16;
+        while (i < block_end) {
+            i = utf16_to_utf8(utf16, n, i, is_little_endian, utf8, mode);
+        }
+    }
+
+    while (i < n) {
+        i = utf16_to_utf8(utf16, n, i, is_little_endian, utf8, mode);
+    }
+
+    return utf8;
+}
+
+inline std::string utf16_to_utf8_avx2(const std::u16string &utf16, bool is_little_endian, Utf8Mode mode = Utf8Mode::Strict) {
+    std::string utf8;
+    utf8.resize(utf16.size() * 3); // Worst case, so the kernel never checks capacity
+
+    char *end = utf16_to_utf8_avx2(utf16.data(), utf16.size(), is_little_endian, &utf8[0], mode);
+    utf8.resize(end - utf8.data());
+
+    return utf8;
+}
+
+// Write the JSON escape for '"', '\\' or a control character and return true, or return
+// false when the code unit can be written as is.
+inline bool json_escape(uint16_t code_unit, char *&utf8) {
+    static const char hex_digits[] = "0123456789abcdef";
+
+    char escape;
+    switch (code_unit) {
+        case '"': escape = '"'; break;
+        case '\\': escape = '\\'; break;
+        case '\b': escape = 'b'; break;
+        case '\f': escape = 'f'; break;
+        case '\n': escape = 'n'; break;
+        case '\r': escape = 'r'; break;
+        case '\t': escape = 't'; break;
+        default:
+            if (code_unit >= 0x20) {
+                return false;
+            }
+            *utf8++ = '\\';
+            *utf8++ = 'u';
+            *utf8++ = '0';
+            *utf8++ = '0';
+            *utf8++ = hex_digits[code_unit >> 4];
+            *utf8++ = hex_digits[code_unit & 0xF];
+            return true;
+    }
+    *utf8++ = '\\';
+    *utf8++ = escape;
+    return true;
+}
+
+// Convert n UTF-16 code units to UTF-8 with JSON string escaping applied in the same pass,
+// returning the end of the output. The destination must have room for n * 6 bytes.
+// Quotes, backslashes and control characters are found by the same vector compare that
+// detects non-ASCII blocks, so clean ASCII blocks are still narrowed with one store.
+inline char *utf16_to_utf8_json_avx2(const char16_t *utf16, size_t n, bool is_little_endian, char *utf8) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i ascii_mask = _mm256_set1_epi16(static_cast<short>(0xFF80));
+    const __m256i control_mask = _mm256_set1_epi16(static_cast<short>(0xFFE0));
+    const __m256i quote = _mm256_set1_epi16('"');
+    const __m256i backslash = _mm256_set1_epi16('\\');
+    const __m256i surrogate_mask = _mm256_set1_epi16(static_cast<short>(0xF800));
+    const __m256i surrogate = _mm256_set1_epi16(static_cast<short>(0xD800));
+
+    size_t i = 0;
+    while (i + 16 <= n) {
+        __m256i in = load_utf16_avx2(utf16 + i, is_little_endian);
+        __m256i escapes = _mm256_or_si256(_mm256_cmpeq_epi16(_mm256_and_si256(in, control_mask), zero),
+                                          _mm256_or_si256(_mm256_cmpeq_epi16(in, quote), _mm256_cmpeq_epi16(in, backslash)));
+        bool needs_escape = !_mm256_testz_si256(escapes, escapes);
+
+        if (!needs_escape && _mm256_testz_si256(in, ascii_mask)) {
+            __m128i packed = _mm_packus_epi16(_mm256_castsi256_si128(in), _mm256_extracti128_si256(in, 1));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(utf8), packed);
+            utf8 += 16;
+            i += 16;
+            continue;
+        }
+
+        __m256i surrogates = _mm256_cmpeq_epi16(_mm256_and_si256(in, surrogate_mask), surrogate);
+        if (!needs_escape && _mm256_testz_si256(surrogates, surrogates)) {
+            for (int j = 0; j < 16; ++j) {
+                uint16_t code_unit = is_little_endian ? utf16[i + j] : swap_bytes(utf16[i + j]);
+                utf16_to_utf8(code_unit, utf8);
+            }
+            i += 16;
+            continue;
+        }
+
+        size_t block_end = i + 16;
+        while (i < block_end) {
+            uint16_t code_unit = is_little_endian ? utf16[i] : swap_bytes(utf16[i]);
+            if (json_escape(code_unit, utf8)) {
+                ++i;
+            } else {
+                i = utf16_to_utf8(utf16, n, i, is_little_endian, utf8);
+            }
+        }
+    }
+
+    while (i < n) {
+        uint16_t code_unit = is_little_endian ? utf16[i] : swap_bytes(utf16[i]);
+        if (json_escape(code_unit, utf8)) {
+            ++i;
+        } else {
+            i = utf16_to_utf8(utf16, n, i, is_little_endian, utf8);
+        }
+    }
+
+    return utf8;
+}
+
+// Convert utf16 to the UTF-8 contents of a JSON string literal, without the quotes
+inline std::string utf16_to_utf8_json_avx2(const std::u16string &utf16, bool is_little_endian) {
+    std::string utf8;
+    utf8.resize(utf16.size() * 6); // Control characters become \u00XX
+
+    char *end = utf16_to_utf8_json_avx2(utf16.data(), utf16.size(), is_little_endian, &utf8[0]);
+    utf8.resize(end - utf8.data());
+
+    return utf8;
+}
+
+// Convert as many whole characters of n UTF-16 code units as fit in max_bytes of UTF-8,
+// writing to utf8 and returning the end of the output. consumed receives the number of
+// code units converted, so oversized input costs time proportional to the budget.
+inline char *utf16_to_utf8_avx2(const char16_t *utf16, size_t n, bool is_little_endian, char *utf8,
+                         size_t max_bytes, size_t &consumed, Utf8Mode mode = Utf8Mode::Strict) {
+    // One block of 16 code units, plus a pair straddling its end, never writes more than this
+    const size_t max_block_bytes = 16 * 3 + 4;
+
+    char *limit = utf8 + max_bytes;
+    size_t i = 0;
+    while (i < n && static_cast<size_t>(limit - utf8) >= max_block_bytes) {
+        // Whole blocks go through the unbounded kernel while the budget surely covers them
+        size_t units = std::min(n - i, (static_cast<size_t>(limit - utf8) / max_block_bytes) * 16);
+        if (units < n - i && units > 0) {
+            uint16_t last = is_little_endian ? utf16[i + units - 1] : swap_bytes(utf16[i + units - 1]);
+            units -= (last & 0xFC00) == 0xD800; // Keep a trailing high surrogate with its pair
+        }
+        if (units == 0) {
+            break;
+        }
+        utf8 = utf16_to_utf8_avx2(utf16 + i, units, is_little_endian, utf8, mode);
+        i += units;
+    }
+
+    // Finish character by character, stopping at the first one that does not fit
+    char buffer[4];
+    while (i < n) {
+        char *end = buffer;
+        size_t next = utf16_to_utf8(utf16, n, i, is_little_endian, end, mode);
+        if (end - buffer > limit - utf8) {
+            break;
+        }
+        std::copy(buffer, end, utf8);
+        utf8 += end - buffer;
+        i = next;
+    }
+
+    consumed = i;
+    return utf8;
+}
+
+// Convert the longest prefix of utf16 whose UTF-8 form fits in max_bytes
+inline std::string utf16_to_utf8_truncated_avx2(const std::u16string &utf16, bool is_little_endian, size_t max_bytes,
+                                         Utf8Mode mode = Utf8Mode::Strict) {
+    std::string utf8;
+    utf8.resize(std::min(max_bytes, utf16.size() * 3));
+
+    size_t consumed;
+    char *end = utf16_to_utf8_avx2(utf16.data(), utf16.size(), is_little_endian, &utf8[0], utf8.size(), consumed, mode);
+    utf8.resize(end - utf8.data());
+
+    return utf8;
+}
+
+// Convert n UTF-16 code units to code points, combining surrogate pairs.
+// The destination must have room for n code points.
+inline char32_t *utf16_to_utf32_avx2(const char16_t *utf16, size_t n, bool is_little_endian, char32_t *utf32) {
+    const __m256i surrogate_mask = _mm256_set1_epi16(static_cast<short>(0xF800));
+    const __m256i surrogate = _mm256_set1_epi16(static_cast<short>(0xD800));
+
+    size_t i = 0;
+    while (i + 16 <= n) {
+        __m256i in = load_utf16_avx2(utf16 + i, is_little_endian);
+        __m256i surrogates = _mm256_cmpeq_epi16(_mm256_and_si256(in, surrogate_mask), surrogate);
+
+        if (_mm256_testz_si256(surrogates, surrogates)) {
+            // Every code unit is a code point, zero-extend them to 32 bits
+            __m256i low = _mm256_cvtepu16_epi32(_mm256_castsi256_si128(in));
+            __m256i high = _mm256_cvtepu16_epi32(_mm256_extracti128_si256(in, 1));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(utf32), low);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(utf32 + 8), high);
+            utf32 += 16;
+            i += 16;
+            continue;
+        }
+
+        size_t block_end = i + 16;
+        while (i < block_end) {
+            i = utf16_to_utf32(utf16, n, i, is_little_endian, utf32);
+        }
+    }
+
+    while (i < n) {
+        i = utf16_to_utf32(utf16, n, i, is_little_endian, utf32);
+    }
+
+    return utf32;
+}
+
+inline std::u32string utf16_to_utf32_avx2(const std::u16string &utf16, bool is_little_endian) {
+    std::u32string utf32;
+    utf32.resize(utf16.size());
+
+    char32_t *end = utf16_to_utf32_avx2(utf16.data(), utf16.size(), is_little_endian, &utf32[0]);
+    utf32.resize(end - utf32.data());
+
+    return utf32;
+}
+
+// True when every one of the 16 code points starting at utf32 is outside the surrogate
+// range and fits in a single UTF-16 code unit (and, with limit = 0x80, is ASCII).
+inline bool utf32_block_below_avx2(const char32_t *utf32, uint32_t limit, __m256i &low, __m256i &high) {
+    const __m256i surrogate_mask = _mm256_set1_epi32(0xFFFFF800);
+    const __m256i surrogate = _mm256_set1_epi32(0xD800);
+    const __m256i max = _mm256_set1_epi32(static_cast<int>(limit - 1));
+
+    low = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(utf32));
+    high = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(utf32 + 8));
+    // Unsigned "greater than limit - 1" as max(x, limit - 1) != limit - 1
+    __m256i too_big = _mm256_or_si256(_mm256_xor_si256(_mm256_max_epu32(low, max), max),
+                                      _mm256_xor_si256(_mm256_max_epu32(high, max), max));
+    __m256i surrogates = _mm256_or_si256(_mm256_cmpeq_epi32(_mm256_and_si256(low, surrogate_mask), surrogate),
+                                         _mm256_cmpeq_epi32(_mm256_and_si256(high, surrogate_mask), surrogate));
+    __m256i invalid = _mm256_or_si256(too_big, surrogates);
+    return _mm256_testz_si256(invalid, invalid);
+}
+
+// Convert n code points to UTF-16 in the requested byte order.
+// The destination must have room for n * 2 code units.
+inline char16_t *utf32_to_utf16_avx2(const char32_t *utf32, size_t n, bool is_little_endian, char16_t *utf16) {
+    size_t i = 0;
+    while (i + 16 <= n) {
+        __m256i low, high;
+        if (utf32_block_below_avx2(utf32 + i, 0x10000, low, high)) {
+            // packus works per 128-bit lane, the permute puts the four quarters back in order
+            __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(low, high), 0xD8);
+            if (!is_little_endian) {
+                packed = _mm256_or_si256(_mm256_srli_epi16(packed, 8), _mm256_slli_epi16(packed, 8));
+            }
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(utf16), packed);
+            utf16 += 16;
+            i += 16;
+            continue;
+        }
+
+        for (size_t block_end = i + 16; i < block_end; ++i) {
+            utf32_to_utf16(utf32[i], is_little_endian, utf16);
+        }
+    }
+
+    for (; i < n; ++i) {
+        utf32_to_utf16(utf32[i], is_little_endian, utf16);
+    }
+
+    return utf16;
+}
+
+inline std::u16string utf32_to_utf16_avx2(const std::u32string &utf32, bool is_little_endian) {
+    std::u16string utf16;
+    utf16.resize(utf32.size() * 2);
+
+    char16_t *end = utf32_to_utf16_avx2(utf32.data(), utf32.size(), is_little_endian, &utf16[0]);
+    utf16.resize(end - utf16.data());
+
+    return utf16;
+}
+
+// Convert n code points to UTF-8. The destination must have room for n * 4 bytes.
+inline char *utf32_to_utf8_avx2(const char32_t *utf32, size_t n, char *utf8) {
+    size_t i = 0;
+    while (i + 16 <= n) {
+        __m256i low, high;
+        if (utf32_block_below_avx2(utf32 + i, 0x80, low, high)) {
+            // All ASCII, narrow 32 -> 16 -> 8 bits
+            __m256i words = _mm256_permute4x64_epi64(_mm256_packus_epi32(low, high), 0xD8);
+            __m128i packed = _mm_packus_epi16(_mm256_castsi256_si128(words), _mm256_extracti128_si256(words, 1));
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(utf8), packed);
+            utf8 += 16;
+            i += 16;
+            continue;
+        }
+
+        for (size_t block_end = i + 16; i < block_end; ++i) {
+            utf32_to_utf8(utf32[i], utf8);
+        }
+    }
+
+    for (; i < n; ++i) {
+        utf32_to_utf8(utf32[i], utf8);
+    }
+
+    return utf8;
+}
+
+inline std::string utf32_to_utf8_avx2(const std::u32string &utf32) {
+    std::string utf8;
+    utf8.resize(utf32.size() * 4);
+
+    char *end = utf32_to_utf8_avx2(utf32.data(), utf32.size(), &utf8[0]);
+    utf8.resize(end - utf8.data());
+
+    return utf8;
+}
+
+// Return the offset of the first unpaired or reversed surrogate in n UTF-16 code units,
+// or n when the input is valid. Nothing is converted, so this runs at load speed.
+//
+// Each block is classified into high and low surrogate masks (two movemask bits per code
+// unit). The input is valid when every low surrogate sits right after a high surrogate,
+// i.e. low == high shifted up by one unit, with the last high of the previous block
+// carried into the next one.
+inline size_t validate_utf16_avx2(const char16_t *utf16, size_t n, bool is_little_endian) {
+    const __m256i surrogate_mask = _mm256_set1_epi16(static_cast<short>(0xFC00));
+    const __m256i high_surrogate = _mm256_set1_epi16(static_cast<short>(0xD800));
+    const __m256i low_surrogate = _mm256_set1_epi16(static_cast<short>(0xDC00));
+
+    uint32_t carry = 0; // 0b11 when the previous code unit was a high surrogate
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m256i in = _mm256_and_si256(load_utf16_avx2(utf16 + i, is_little_endian), surrogate_mask);
+        uint32_t high = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi16(in, high_surrogate)));
+        uint32_t low = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi16(in, low_surrogate)));
+
+        uint32_t errors = low ^ ((high << 2) | carry);
+        if (errors != 0) {
+            size_t pos = i + count_trailing_zeros(errors) / 2;
+            // A missing low surrogate is the fault of the high surrogate before it
+            return (low >> (pos - i) * 2) & 1 ? pos : pos - 1;
+        }
+        carry = high >> 30;
+    }
+
+    for (; i < n; ++i) {
+        uint16_t code_unit = is_little_endian ? utf16[i] : swap_bytes(utf16[i]);
+        bool is_low = (code_unit & 0xFC00) == 0xDC00;
+        if (is_low != (carry != 0)) {
+            return is_low ? i : i - 1;
+        }
+        carry = (code_unit & 0xFC00) == 0xD800 ? 3 : 0;
+    }
+
+    return carry != 0 ? n - 1 : n;
+}
+
+inline bool is_valid_utf16_avx2(const std::u16string &utf16, bool is_little_endian) {
+    return validate_utf16_avx2(utf16.data(), utf16.size(), is_little_endian) == utf16.size();
+}
+
+// Count the UTF-8 bytes needed for n valid UTF-16 code units without converting them.
+// Each unit needs 1 byte, plus 1 from 0x80 and another from 0x800; a surrogate pair
+// counts 3 + 3 that way, so each surrogate gives one back to reach 4.
+inline size_t utf8_length_avx2(const char16_t *utf16, size_t n, bool is_little_endian) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i two = _mm256_set1_epi16(2);
+    const __m256i one = _mm256_set1_epi16(1);
+    const __m256i mask1 = _mm256_set1_epi16(static_cast<short>(0xFF80));
+    const __m256i mask2 = _mm256_set1_epi16(static_cast<short>(0xF800));
+    const __m256i surrogate = _mm256_set1_epi16(static_cast<short>(0xD800));
+
+    size_t length = n;
+    size_t i = 0;
+    while (i + 16 <= n) {
+        // Each lane grows by at most 2 per block, flush before the 16-bit lanes can overflow
+        __m256i extra = zero;
+        size_t block_end = std::min(n - n % 16, i + 16 * 16383);
+        for (; i < block_end; i += 16) {
+            __m256i in = load_utf16_avx2(utf16 + i, is_little_endian);
+            __m256i is_ascii = _mm256_cmpeq_epi16(_mm256_and_si256(in, mask1), zero);
+            __m256i is_two = _mm256_cmpeq_epi16(_mm256_and_si256(in, mask2), zero);
+            __m256i is_surrogate = _mm256_cmpeq_epi16(_mm256_and_si256(in, mask2), surrogate);
+            // Masks are -1 when set: 2 - ascii - two - surrogate gives the extra bytes per unit
+            __m256i lane = _mm256_add_epi16(_mm256_add_epi16(two, is_ascii), _mm256_add_epi16(is_two, is_surrogate));
+            extra = _mm256_add_epi16(extra, lane);
+        }
+
+        __m256i sums = _mm256_madd_epi16(extra, one);
+        __m128i sum = _mm_add_epi32(_mm256_castsi256_si128(sums), _mm256_extracti128_si256(sums, 1));
+        sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+        sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+        length += static_cast<uint32_t>(_mm_cvtsi128_si32(sum));
+    }
+
+    for (; i < n; ++i) {
+        uint16_t code_unit = is_little_endian ? utf16[i] : swap_bytes(utf16[i]);
+        if (code_unit >= 0xD800 && code_unit <= 0xDFFF) {
+            length += 1;
+        } else if (code_unit >= 0x800) {
+            length += 2;
+        } else if (code_unit >= 0x80) {
+            length += 1;
+        }
+    }
+
+    return length;
+}
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+inline uint16x8_t load_utf16_neon(const char16_t *data, bool is_little_endian) {
+    uint16x8_t in = vld1q_u16(reinterpret_cast<const uint16_t *>(data));
+    if (!is_little_endian) {
+        in = vreinterpretq_u16_u8(vrev16q_u8(vreinterpretq_u8_u16(in))); // Swap bytes for big endian
+    }
+    return in;
+}
+
+// Convert n UTF-16 code units to UTF-8, writing to utf8 and returning the end of the output.
+// The destination must have room for n * 3 bytes. Works like utf16_to_utf8_avx2 on blocks
+// of 16 code units held in two registers.
+inline char *utf16_to_utf8_neon(const char16_t *utf16, size_t n, bool is_little_endian, char *utf8,
+                         Utf8Mode mode = Utf8Mode::Strict) {
+    const uint16x8_t surrogate_mask = vdupq_n_u16(0xF800);
+    const uint16x8_t surrogate = vdupq_n_u16(0xD800);
+
+    size_t i = 0;
+    while (i + 16 <= n) {
+        uint16x8_t first = load_utf16_neon(utf16 + i, is_little_endian);
+        uint16x8_t second = load_utf16_neon(utf16 + i + 8, is_little_endian);
+
+        // Modified UTF-8 writes NUL as two bytes, so it cannot take the narrowing path
+        bool has_nul = mode == Utf8Mode::ModifiedUtf8 && vminvq_u16(vminq_u16(first, second)) == 0;
+
+        if (vmaxvq_u16(vorrq_u16(first, second)) < 0x80 && !has_nul) {
+            // All 16 code units are ASCII, narrow them to bytes in one store
+            vst1q_u8(reinterpret_cast<uint8_t *>(utf8), vcombine_u8(vmovn_u16(first), vmovn_u16(second)));
+            utf8 += 16;
+            i += 16;
+            continue;
+        }
+
+        uint16x8_t surrogates = vorrq_u16(vceqq_u16(vandq_u16(first, surrogate_mask), surrogate),
+                                          vceqq_u16(vandq_u16(second, surrogate_mask), surrogate));
+        if (vmaxvq_u16(surrogates) == 0 && !has_nul) {
+            // No surrogates, every mode encodes each code unit on its own
+            for (int j = 0; j < 16; ++j) {
+                uint16_t code_unit = is_little_endian ? utf16[i + j] : swap_bytes(utf16[i + j]);
+                utf16_to_utf8(code_unit, utf8);
+            }
+            i += 16;
+            continue;
+        }
+
+        // A surrogate pair may straddle the block end, so the scalar loop can overshoot by one
+        size_t block_end = i + 16;
+        while (i < block_end) {
+            i = utf16_to_utf8(utf16, n, i, is_little_endian, utf8, mode);
+        }
+    }
+
+    while (i < n) {
+        i = utf16_to_utf8(utf16, n, i, is_little_endian, utf8, mode);
+    }
+
+    return utf8;
+}
+
+// Same contract as validate_utf16_avx2. NEON has no movemask, so the compare results are
+// narrowed into a 64-bit mask with eight bits per code unit instead of two.
+inline size_t validate_utf16_neon(const char16_t *utf16, size_t n, bool is_little_endian) {
+    const uint16x8_t surrogate_mask = vdupq_n_u16(0xFC00);
+    const uint16x8_t high_surrogate = vdupq_n_u16(0xD800);
+    const uint16x8_t low_surrogate = vdupq_n_u16(0xDC00);
+
+    uint64_t carry = 0; // 0xFF when the previous code unit was a high surrogate
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint16x8_t in = vandq_u16(load_utf16_neon(utf16 + i, is_little_endian), surrogate_mask);
+        uint64_t high = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vceqq_u16(in, high_surrogate), 4)), 0);
+        uint64_t low = vget_lane_u64(vreinterpret_u64_u8(vshrn_n_u16(vceqq_u16(in, low_surrogate), 4)), 0);
+
+        uint64_t errors = low ^ ((high << 8) | carry);
+        if (errors != 0) {
+            size_t pos = i + count_trailing_zeros64(errors) / 8;
+            // A missing low surrogate is the fault of the high surrogate before it
+            return (low >> (pos - i) * 8) & 1 ? pos : pos - 1;
+        }
+        carry = high >> 56;
+    }
+
+    for (; i < n; ++i) {
+        uint16_t code_unit = is_little_endian ? utf16[i] : swap_bytes(utf16[i]);
+        bool is_low = (code_unit & 0xFC00) == 0xDC00;
+        if (is_low != (carry != 0)) {
+            return is_low ? i : i - 1;
+        }
+        carry = (code_unit & 0xFC00) == 0xD800 ? 0xFF : 0;
+    }
+
+    return carry != 0 ? n - 1 : n;
+}
+
+// Same counting as utf8_length_avx2
+inline size_t utf8_length_neon(const char16_t *utf16, size_t n, bool is_little_endian) {
+    const uint16x8_t two = vdupq_n_u16(2);
+    const uint16x8_t ascii_limit = vdupq_n_u16(0x80);
+    const uint16x8_t two_byte_limit = vdupq_n_u16(0x800);
+    const uint16x8_t surrogate_mask = vdupq_n_u16(0xF800);
+    const uint16x8_t surrogate = vdupq_n_u16(0xD800);
+
+    size_t length = n;
+    size_t i = 0;
+    while (i + 8 <= n) {
+        // Each lane grows by at most 2 per block, flush before the 16-bit lanes can overflow
+        uint16x8_t extra = vdupq_n_u16(0);
+        size_t block_end = std::min(n - n % 8, i + 8 * 32767);
+        for (; i < block_end; i += 8) {
+            uint16x8_t in = load_utf16_neon(utf16 + i, is_little_endian);
+            uint16x8_t is_ascii = vcltq_u16(in, ascii_limit);
+            uint16x8_t is_two = vcltq_u16(in, two_byte_limit);
+            uint16x8_t is_surrogate = vceqq_u16(vandq_u16(in, surrogate_mask), surrogate);
+            // Masks are all ones when set, so adding one takes 1 off the 2 extra bytes
+            uint16x8_t lane = vaddq_u16(vaddq_u16(two, is_ascii), vaddq_u16(is_two, is_surrogate));
+            extra = vaddq_u16(extra, lane);
+        }
+        length += vaddlvq_u16(extra);
+    }
+
+    for (; i < n; ++i) {
+        uint16_t code_unit = is_little_endian ? utf16[i] : swap_bytes(utf16[i]);
+        if (code_unit >= 0xD800 && code_unit <= 0xDFFF) {
+            length += 1;
+        } else if (code_unit >= 0x800) {
+            length += 2;
+        } else if (code_unit >= 0x80) {
+            length += 1;
+        }
+    }
+
+    return length;
+}
+#endif
+
+// The _simd functions use the best kernel the build targets, or plain loops over the scalar
+// helpers when it has neither AVX2 nor NEON. The parallel and batch converters build on them.
+inline char *utf16_to_utf8_simd(const char16_t *utf16, size_t n, bool is_little_endian, char *utf8,
+                         Utf8Mode mode = Utf8Mode::Strict) {
+#if defined(__x86_64__) || defined(_M_X64)
+    return utf16_to_utf8_avx2(utf16, n, is_little_endian, utf8, mode);
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    return utf16_to_utf8_neon(utf16, n, is_little_endian, utf8, mode);
+#else
+    for (size_t i = 0; i < n;) {
+        i = utf16_to_utf8(utf16, n, i, is_little_endian, utf8, mode);
+    }
+    return utf8;
+#endif
+}
+
+inline std::string utf16_to_utf8_simd(const std::u16string &utf16, bool is_little_endian, Utf8Mode mode = Utf8Mode::Strict) {
+    std::string utf8;
+    utf8.resize(utf16.size() * 3); // Worst case, so the kernel never checks capacity
+
+    char *end = utf16_to_utf8_simd(utf16.data(), utf16.size(), is_little_endian, &utf8[0], mode);
+    utf8.resize(end - utf8.data());
+
+    return utf8;
+}
+
+inline size_t validate_utf16_simd(const char16_t *utf16, size_t n, bool is_little_endian) {
+#if defined(__x86_64__) || defined(_M_X64)
+    return validate_utf16_avx2(utf16, n, is_little_endian);
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    return validate_utf16_neon(utf16, n, is_little_endian);
+#else
+    bool after_high = false;
+    for (size_t i = 0; i < n; ++i) {
+        uint16_t code_unit = is_little_endian ? utf16[i] : swap_bytes(utf16[i]);
+        bool is_low = (code_unit & 0xFC00) == 0xDC00;
+        if (is_low != after_high) {
+            return is_low ? i : i - 1;
+        }
+        after_high = (code_unit & 0xFC00) == 0xD800;
+    }
+    return after_high ? n - 1 : n;
+#endif
+}
+
+inline size_t utf8_length_simd(const char16_t *utf16, size_t n, bool is_little_endian) {
+#if defined(__x86_64__) || defined(_M_X64)
+    return utf8_length_avx2(utf16, n, is_little_endian);
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    return utf8_length_neon(utf16, n, is_little_endian);
+#else
+    size_t length = n;
+    for (size_t i = 0; i < n; ++i) {
+        uint16_t code_unit = is_little_endian ? utf16[i] : swap_bytes(utf16[i]);
+        length += code_unit >= 0x80;
+        length += code_unit >= 0x800 && (code_unit & 0xF800) != 0xD800;
+    }
+    return length;
+#endif
+}
+
+// Run fn(0) .. fn(count - 1) on their own threads, the first on the calling thread,
+// and rethrow the first exception any of them raised.
+template <typename Fn>
+inline void run_parallel(size_t count, Fn fn) {
+    std::vector<std::exception_ptr> errors(count);
+    std::vector<std::thread> workers;
+    workers.reserve(count - 1);
+
+    auto guarded = [&](size_t k) {
+        try {
+            fn(k);
+        } catch (...) {
+            errors[k] = std::current_exception();
+        }
+    };
+    for (size_t k = 1; k < count; ++k) {
+        workers.emplace_back(guarded, k);
+    }
+    guarded(0);
+    for (auto &worker : workers) {
+        worker.join();
+    }
+
+    for (const auto &error : errors) {
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+}
+
+// Split the input into one chunk per thread, never between the halves of a surrogate pair.
+// Every chunk measures its UTF-8 size first; after a prefix sum each worker converts its
+// chunk straight into its own slice of the single output string.
+inline std::string utf16_to_utf8_parallel(const std::u16string &utf16, bool is_little_endian, size_t num_threads = 0) {
+    const size_t min_chunk_size = 64 * 1024; // Below this thread start-up costs more than it saves
+
+    size_t n = utf16.size();
+    if (num_threads == 0) {
+        num_threads = std::max<size_t>(1, std::thread::hardware_concurrency());
+    }
+    size_t num_chunks = std::min(num_threads, std::max<size_t>(1, n / min_chunk_size));
+    if (num_chunks == 1) {
+        return utf16_to_utf8_simd(utf16, is_little_endian);
+    }
+
+    const char16_t *data = utf16.data();
+    std::vector<size_t> bounds(num_chunks + 1);
+    for (size_t k = 1; k < num_chunks; ++k) {
+        size_t pos = n / num_chunks * k;
+        uint16_t code_unit = is_little_endian ? data[pos] : swap_bytes(data[pos]);
+        if (code_unit >= 0xDC00 && code_unit <= 0xDFFF) {
+            ++pos; // Keep the low surrogate with its high surrogate
+        }
+        bounds[k] = pos;
+    }
+    bounds[num_chunks] = n;
+
+    std::vector<size_t> offsets(num_chunks + 1);
+    run_parallel(num_chunks, [&](size_t k) {
+        offsets[k + 1] = utf8_length_simd(data + bounds[k], bounds[k + 1] - bounds[k], is_little_endian);
+    });
+    for (size_t k = 0; k < num_chunks; ++k) {
+        offsets[k + 1] += offsets[k];
+    }
+
+    std::string utf8;
+    utf8.resize(offsets[num_chunks]);
+    char *out = &utf8[0];
+    run_parallel(num_chunks, [&](size_t k) {
+        char *end = utf16_to_utf8_simd(data + bounds[k], bounds[k + 1] - bounds[k], is_little_endian, out + offsets[k]);
+        if (end != out + offsets[k + 1]) {
+            throw std::runtime_error("Invalid UTF-16 sequence");
+        }
+    });
+
+    return utf8;
+}
+
+// Convert a batch of UTF-16 strings into one UTF-8 arena. The results are appended to
+// arena, and string k of the batch ends up at [offsets[base + k], offsets[base + k + 1]),
+// where base is offsets.size() - 1 on entry (offsets gets a leading 0 when empty).
+// Reusing the same arena and offsets across batches avoids allocating per string.
+//
+// Views that sit back to back in memory, as slices of one columnar buffer do, are
+// coalesced into runs so the vector loop crosses string boundaries; an all-ASCII run
+// is narrowed in a single kernel call and its offsets follow from the input lengths.
+inline void utf16_to_utf8_batch(const std::u16string_view *strings, size_t count, bool is_little_endian,
+                         std::string &arena, std::vector<size_t> &offsets) {
+    const size_t max_run_size = 4096; // Keeps one non-ASCII string from slowing a whole column
+
+    struct Run {
+        size_t first;
+        size_t last;
+        size_t utf8_length;
+    };
+    std::vector<Run> runs;
+
+    size_t length = 0;
+    for (size_t k = 0; k < count;) {
+        const char16_t *begin = strings[k].data();
+        size_t units = strings[k].size();
+        size_t last = k + 1;
+        while (last < count && strings[last].data() == begin + units && units + strings[last].size() <= max_run_size) {
+            units += strings[last].size();
+            ++last;
+        }
+
+        Run run{k, last, utf8_length_simd(begin, units, is_little_endian)};
+        length += run.utf8_length;
+        runs.push_back(run);
+        k = last;
+    }
+
+    size_t arena_size = arena.size();
+    size_t offsets_size = offsets.size();
+    arena.resize(arena_size + length);
+    offsets.reserve(offsets_size + count + 1);
+    if (offsets.empty()) {
+        offsets.push_back(arena_size);
+    }
+
+    try {
+        char *out = &arena[0] + arena_size;
+        for (const Run &run : runs) {
+            const char16_t *begin = strings[run.first].data();
+            size_t units = 0;
+            for (size_t k = run.first; k < run.last; ++k) {
+                units += strings[k].size();
+            }
+
+            if (run.utf8_length == units) {
+                // Every code unit is ASCII, so each string keeps its length
+                utf16_to_utf8_simd(begin, units, is_little_endian, out);
+                for (size_t k = run.first; k < run.last; ++k) {
+                    offsets.push_back(offsets.back() + strings[k].size());
+                }
+                out += units;
+                continue;
+            }
+
+            for (size_t k = run.first; k < run.last; ++k) {
+                out = utf16_to_utf8_simd(strings[k].data(), strings[k].size(), is_little_endian, out);
+                offsets.push_back(out - arena.data());
+            }
+        }
+        if (out != arena.data() + arena.size()) {
+            throw std::runtime_error("Invalid UTF-16 sequence");
+        }
+    } catch (...) {
+        arena.resize(arena_size);
+        offsets.resize(offsets_size);
+        throw;
+    }
+}
+
+#endif // POTIMIZER_UTF16_TO_UTF8_H
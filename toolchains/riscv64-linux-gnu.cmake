@@ -0,0 +1,21 @@
+# Cross-compile for 64-bit RISC-V with the vector extension and run under qemu-user:
+#   cmake -S SIMD -B build-riscv64 -DCMAKE_TOOLCHAIN_FILE=$PWD/toolchains/riscv64-linux-gnu.cmake
+#   cmake --build build-riscv64 --target run
+# Needs riscv64-linux-gnu-g++ 13 or newer (RVV 1.0 intrinsics) and qemu-riscv64 8 or newer.
+set(CMAKE_SYSTEM_NAME Linux)
+set(CMAKE_SYSTEM_PROCESSOR riscv64)
+
+set(CMAKE_C_COMPILER riscv64-linux-gnu-gcc)
+set(CMAKE_CXX_COMPILER riscv64-linux-gnu-g++)
+set(CMAKE_C_FLAGS_INIT "-march=rv64gcv")
+set(CMAKE_CXX_FLAGS_INIT "-march=rv64gcv")
+
+set(CMAKE_FIND_ROOT_PATH /usr/riscv64-linux-gnu)
+set(CMAKE_FIND_ROOT_PATH_MODE_PROGRAM NEVER)
+set(CMAKE_FIND_ROOT_PATH_MODE_LIBRARY ONLY)
+set(CMAKE_FIND_ROOT_PATH_MODE_INCLUDE ONLY)
+
+# VLEN is the vector register width in bits; rerun with e.g. -DRISCV_VLEN=512 to check the
+# kernels do not depend on it
+set(RISCV_VLEN 128 CACHE STRING "Vector register width emulated by qemu")
+set(CMAKE_CROSSCOMPILING_EMULATOR qemu-riscv64 -L /usr/riscv64-linux-gnu -cpu rv64,v=true,vlen=${RISCV_VLEN})